@@ -2,7 +2,21 @@
 #include <vector>
 #include <random>
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <sys/resource.h>
 
 using namespace std;
 
@@ -11,176 +25,1924 @@ struct CampusVisit
   int campusId;
   string campusName;
 };
-// Function to print a route
-void printRoute(const vector<CampusVisit>& route)
+
+// Frees memory from aligned_alloc
+struct AlignedFree
+{
+  void operator()(void* p) const { free(p); }
+};
+
+// Cache line aligned array of n values
+template <typename T>
+unique_ptr<T[], AlignedFree> allocateAligned(size_t n)
+{
+  size_t bytes = ((n * sizeof(T) + 63) / 64) * 64;
+  T* data = static_cast<T*>(aligned_alloc(64, bytes == 0 ? 64 : bytes));
+  if (data == nullptr)
+  {
+    throw bad_alloc();
+  }
+  return unique_ptr<T[], AlignedFree>(data);
+}
+
+// Distances between every pair of cities, for any number of cities.
+// FULL is a contiguous row-major matrix of doubles with rows padded to a cache line.
+// TRIANGULAR keeps only the lower triangle as floats (symmetric instances only).
+// COORDINATES keeps the x/y coordinates and works distances out on every lookup,
+// which is the only layout that still fits in memory for very large instances.
+class DistanceMatrix
+{
+public:
+  enum Layout
+  {
+    AUTO,
+    FULL,
+    TRIANGULAR,
+    COORDINATES
+  };
+
+  DistanceMatrix() {}
+
+  // Builds a FULL matrix from explicit rows
+  static DistanceMatrix fromRows(const vector<vector<double>>& rows)
+  {
+    DistanceMatrix matrix;
+    matrix.initialise(rows.size(), FULL);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+      for (size_t j = 0; j < rows.size(); ++j)
+      {
+        matrix.set(i, j, rows[i][j]);
+      }
+    }
+    return matrix;
+  }
+
+  // Euclidean distances between points. Rounded to the nearest integer like TSPLIB EUC_2D when rounded is set.
+  static DistanceMatrix fromCoordinates(const vector<double>& x, const vector<double>& y, bool rounded, Layout layout = AUTO)
+  {
+    DistanceMatrix matrix;
+    matrix.x = x;
+    matrix.y = y;
+    matrix.rounded = rounded;
+    matrix.symmetric = true;
+    if (layout == AUTO)
+    {
+      layout = x.size() <= fullLimit ? FULL : (x.size() <= triangularLimit ? TRIANGULAR : COORDINATES);
+    }
+    matrix.initialise(x.size(), layout);
+    if (layout != COORDINATES)
+    {
+      for (size_t i = 0; i < matrix.n; ++i)
+      {
+        for (size_t j = layout == FULL ? 0 : i + 1; j < matrix.n; ++j)
+        {
+          matrix.set(i, j, matrix.euclidean(i, j));
+        }
+      }
+    }
+    return matrix;
+  }
+
+  size_t size() const { return n; }
+  Layout getLayout() const { return layout; }
+  // Matrices built from points keep them whatever the layout; explicit weights have none
+  bool hasCoordinates() const { return !x.empty(); }
+  const vector<double>& xCoordinates() const { return x; }
+  const vector<double>& yCoordinates() const { return y; }
+
+  double operator()(int from, int to) const
+  {
+    switch (layout)
+    {
+    case FULL:
+      return full[from * stride + to];
+    case TRIANGULAR:
+      if (from == to)
+      {
+        return 0;
+      }
+      return from > to ? triangle[triangleIndex(from, to)] : triangle[triangleIndex(to, from)];
+    default:
+      return euclidean(from, to);
+    }
+  }
+
+  // Bytes used by the distance storage itself
+  size_t memoryUsage() const
+  {
+    switch (layout)
+    {
+    case FULL:
+      return n * stride * sizeof(double);
+    case TRIANGULAR:
+      return n * (n - 1) / 2 * sizeof(float);
+    default:
+      return (x.size() + y.size()) * sizeof(double);
+    }
+  }
+
+  friend bool loadTsplib(const string& fileName, DistanceMatrix& matrix, vector<string>& names, Layout layout);
+
+private:
+  static const size_t fullLimit = 4096;        // 128 MB of doubles
+  static const size_t triangularLimit = 16384; // 512 MB of floats
+
+  size_t n = 0;
+  size_t stride = 0;
+  Layout layout = FULL;
+  bool rounded = false;
+  bool symmetric = false; // set() mirrors each entry into the other half of a FULL matrix
+  unique_ptr<double[], AlignedFree> full;
+  unique_ptr<float[], AlignedFree> triangle;
+  vector<double> x, y;
+
+  static size_t triangleIndex(size_t row, size_t column) { return row * (row - 1) / 2 + column; }
+
+  void initialise(size_t size, Layout newLayout)
+  {
+    n = size;
+    layout = newLayout;
+    if (layout == FULL)
+    {
+      stride = ((n + 7) / 8) * 8;
+      full = allocateAligned<double>(n * stride);
+      fill(full.get(), full.get() + n * stride, 0.0);
+    }
+    else if (layout == TRIANGULAR)
+    {
+      triangle = allocateAligned<float>(n * (n - 1) / 2);
+    }
+  }
+
+  // Stores a distance. TRIANGULAR only keeps one direction so i and j may be given either way round.
+  void set(size_t i, size_t j, double distance)
+  {
+    if (layout == FULL)
+    {
+      full[i * stride + j] = distance;
+      if (symmetric)
+      {
+        full[j * stride + i] = distance;
+      }
+    }
+    else if (layout == TRIANGULAR && i != j)
+    {
+      triangle[i > j ? triangleIndex(i, j) : triangleIndex(j, i)] = static_cast<float>(distance);
+    }
+  }
+
+  double euclidean(size_t i, size_t j) const
+  {
+    double dx = x[i] - x[j];
+    double dy = y[i] - y[j];
+    double distance = sqrt(dx * dx + dy * dy);
+    return rounded ? floor(distance + 0.5) : distance;
+  }
+};
+
+// Loads a TSPLIB file with either NODE_COORD_SECTION (EUC_2D/CEIL_2D) or an
+// explicit EDGE_WEIGHT_SECTION (FULL_MATRIX, UPPER_ROW, LOWER_ROW, UPPER_DIAG_ROW, LOWER_DIAG_ROW).
+// names gets one entry per city. Prints the problem and returns false on failure.
+bool loadTsplib(const string& fileName, DistanceMatrix& matrix, vector<string>& names, DistanceMatrix::Layout layout = DistanceMatrix::AUTO)
+{
+  ifstream file(fileName);
+  if (!file)
+  {
+    cerr << "Failed to open " << fileName << endl;
+    return false;
+  }
+  size_t dimension = 0;
+  string weightType, weightFormat, line;
+  while (getline(file, line))
+  {
+    size_t colon = line.find(':');
+    string key = line.substr(0, colon);
+    key.erase(remove_if(key.begin(), key.end(), ::isspace), key.end());
+    string value = colon == string::npos ? "" : line.substr(colon + 1);
+    value.erase(remove_if(value.begin(), value.end(), ::isspace), value.end());
+    if (key == "DIMENSION")
+    {
+      dimension = stoul(value);
+    }
+    else if (key == "EDGE_WEIGHT_TYPE")
+    {
+      weightType = value;
+    }
+    else if (key == "EDGE_WEIGHT_FORMAT")
+    {
+      weightFormat = value;
+    }
+    else if (key == "NODE_COORD_SECTION" || key == "EDGE_WEIGHT_SECTION" || key == "EOF")
+    {
+      break;
+    }
+  }
+  if (dimension == 0)
+  {
+    cerr << fileName << ": missing DIMENSION" << endl;
+    return false;
+  }
+  names.clear();
+  for (size_t i = 0; i < dimension; ++i)
+  {
+    names.push_back(to_string(i + 1));
+  }
+
+  if (weightType == "EUC_2D" || weightType == "CEIL_2D")
+  {
+    vector<double> x(dimension), y(dimension);
+    for (size_t i = 0; i < dimension; ++i)
+    {
+      size_t node;
+      if (!(file >> node >> x[i] >> y[i]))
+      {
+        cerr << fileName << ": expected " << dimension << " coordinates" << endl;
+        return false;
+      }
+    }
+    matrix = DistanceMatrix::fromCoordinates(x, y, true, layout);
+    if (weightType == "CEIL_2D")
+    {
+      cerr << fileName << ": CEIL_2D distances are rounded to nearest" << endl;
+    }
+    return true;
+  }
+  if (weightType != "EXPLICIT")
+  {
+    cerr << fileName << ": unsupported EDGE_WEIGHT_TYPE " << weightType << endl;
+    return false;
+  }
+
+  bool upper = weightFormat == "UPPER_ROW" || weightFormat == "UPPER_DIAG_ROW";
+  bool lower = weightFormat == "LOWER_ROW" || weightFormat == "LOWER_DIAG_ROW";
+  bool diagonal = weightFormat == "UPPER_DIAG_ROW" || weightFormat == "LOWER_DIAG_ROW";
+  if (!upper && !lower && weightFormat != "FULL_MATRIX")
+  {
+    cerr << fileName << ": unsupported EDGE_WEIGHT_FORMAT " << weightFormat << endl;
+    return false;
+  }
+  if (layout == DistanceMatrix::AUTO || layout == DistanceMatrix::COORDINATES)
+  {
+    // There are no coordinates to fall back on, so the weights have to be stored
+    layout = dimension <= DistanceMatrix::fullLimit || (!upper && !lower) ? DistanceMatrix::FULL : DistanceMatrix::TRIANGULAR;
+  }
+  if (layout == DistanceMatrix::TRIANGULAR && !upper && !lower)
+  {
+    cerr << fileName << ": a FULL_MATRIX is checked for symmetry in the full layout" << endl;
+    layout = DistanceMatrix::FULL;
+  }
+  matrix = DistanceMatrix();
+  matrix.symmetric = upper || lower;
+  matrix.initialise(dimension, layout);
+  for (size_t i = 0; i < dimension; ++i)
+  {
+    size_t first = 0, last = dimension;
+    if (upper)
+    {
+      first = diagonal ? i : i + 1;
+    }
+    else if (lower)
+    {
+      last = diagonal ? i + 1 : i;
+    }
+    for (size_t j = first; j < last; ++j)
+    {
+      double distance;
+      if (!(file >> distance))
+      {
+        cerr << fileName << ": EDGE_WEIGHT_SECTION is too short" << endl;
+        return false;
+      }
+      matrix.set(i, j, distance);
+    }
+  }
+  // The move deltas assume d(a, b) == d(b, a); on an asymmetric instance they stop
+  // matching the tour length and local search can cycle forever
+  if (!upper && !lower)
+  {
+    for (size_t i = 0; i < dimension; ++i)
+    {
+      for (size_t j = i + 1; j < dimension; ++j)
+      {
+        if (matrix(i, j) != matrix(j, i))
+        {
+          cerr << fileName << ": asymmetric FULL_MATRIX (d(" << i + 1 << "," << j + 1 << ") = " << matrix(i, j)
+               << ", d(" << j + 1 << "," << i + 1 << ") = " << matrix(j, i) << "), only symmetric TSP is supported" << endl;
+          return false;
+        }
+      }
+    }
+    matrix.symmetric = true;
+  }
+  return true;
+}
+// A route as a permutation of city indices. order[0] is the start city and order
+// ends with it again; position[c] is where city c is in order (its first visit).
+// Assigning one Tour to another of the same size reuses the existing buffers,
+// so the solvers can keep copies of the best route without allocating.
+struct Tour
+{
+  vector<uint32_t> order;
+  vector<uint32_t> position;
+
+  size_t size() const { return order.size(); }
+  uint32_t operator[](size_t i) const { return order[i]; }
+
+  // Swaps the cities at positions i and j (neither may be the start or end)
+  void swapPositions(size_t i, size_t j)
+  {
+    swap(order[i], order[j]);
+    position[order[i]] = i;
+    position[order[j]] = j;
+  }
+
+  // Refreshes position for order[first..last] after they were moved around
+  void updatePositions(size_t first, size_t last)
+  {
+    for (size_t i = first; i <= last; ++i)
+    {
+      position[order[i]] = i;
+    }
+  }
+};
+
+// Function to print a route. Names are looked up in campuses by city index.
+void printRoute(const Tour& route, const vector<CampusVisit>& campuses)
+{
+  for (size_t i = 0; i < route.size(); ++i)
+  {
+    cout << campuses[route[i]].campusName;
+    if (i + 1 != route.size())
+    {
+      cout << "->";
+    }
+  }
+  cout << endl;
+}
+struct TracePoint
+{
+  uint64_t iteration;
+  double distance;
+};
+
+// Writes trace points to a file on its own thread so the solvers never wait on disk.
+// Files ending in .bin get packed {uint32 trace, uint64 iteration, double distance}
+// records, anything else gets "trace,iteration,distance" CSV lines.
+// Several traces (one per trajectory) can share one writer.
+class TraceWriter
+{
+public:
+  explicit TraceWriter(const string& fileName)
+  {
+    binary = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".bin") == 0;
+    file.open(fileName, binary ? ios::binary : ios::out);
+    if (!binary)
+    {
+      file << "trace,iteration,distance\n";
+    }
+    writerThread = thread(&TraceWriter::run, this);
+  }
+
+  ~TraceWriter()
+  {
+    {
+      lock_guard<mutex> guard(lock);
+      closing = true;
+    }
+    changed.notify_all();
+    writerThread.join();
+  }
+
+  bool isOpen() const { return file.is_open(); }
+
+  // Queues batch for writing and leaves it empty. Blocks only if the writer is far behind.
+  void submit(uint32_t trace, vector<TracePoint>& batch)
+  {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [&]() { return pending.size() < maxPending; });
+    pending.emplace_back(trace, vector<TracePoint>());
+    pending.back().second.swap(batch);
+    guard.unlock();
+    changed.notify_all();
+  }
+
+private:
+  static const size_t maxPending = 64;
+  ofstream file;
+  bool binary;
+  mutex lock;
+  condition_variable changed;
+  deque<pair<uint32_t, vector<TracePoint>>> pending;
+  bool closing = false;
+  thread writerThread;
+
+  void run()
+  {
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+      changed.wait(guard, [&]() { return closing || !pending.empty(); });
+      if (pending.empty())
+      {
+        return;
+      }
+      pair<uint32_t, vector<TracePoint>> batch = move(pending.front());
+      pending.pop_front();
+      guard.unlock();
+      changed.notify_all();
+      for (const TracePoint& point : batch.second)
+      {
+        if (binary)
+        {
+          file.write(reinterpret_cast<const char*>(&batch.first), sizeof(batch.first));
+          file.write(reinterpret_cast<const char*>(&point.iteration), sizeof(point.iteration));
+          file.write(reinterpret_cast<const char*>(&point.distance), sizeof(point.distance));
+        }
+        else
+        {
+          file << batch.first << ',' << point.iteration << ',' << point.distance << '\n';
+        }
+      }
+      guard.lock();
+    }
+  }
+};
+
+// Records how the best distance of a search falls without keeping a value per iteration.
+// IMPROVEMENTS keeps only the iterations where the best distance went down.
+// DECIMATED keeps every stride-th iteration; when capacity points are held, every
+// other point is dropped and the stride doubles, so memory stays fixed however long the run.
+// Either way, points can also be streamed to a TraceWriter in batches.
+class ConvergenceTrace
+{
+public:
+  enum Mode
+  {
+    IMPROVEMENTS,
+    DECIMATED
+  };
+
+  ConvergenceTrace(Mode mode = DECIMATED, size_t capacity = 1024, TraceWriter* writer = nullptr, uint32_t id = 0)
+    : mode(mode), capacity(max<size_t>(capacity, 2)), writer(writer), id(id) {}
+
+  // Called once per iteration with the best distance so far
+  void record(uint64_t iteration, double distance)
+  {
+    sum += distance;
+    ++count;
+    lastIteration = iteration;
+    if (mode == IMPROVEMENTS ? distance < best : --untilNext == 0)
+    {
+      keep(iteration, distance);
+    }
+    best = distance;
+  }
+
+  // Sends anything still buffered to the writer. Call when the search is done.
+  void finish()
+  {
+    if (writer != nullptr && !batch.empty())
+    {
+      writer->submit(id, batch);
+    }
+  }
+
+  const vector<TracePoint>& getPoints() const { return points; }
+  double bestDistance() const { return best; }
+  double averageDistance() const { return count == 0 ? 0 : sum / count; }
+  uint64_t iterations() const { return lastIteration + 1; }
+  // True while every recorded iteration is still in getPoints()
+  bool isComplete() const { return mode == DECIMATED && stride == 1; }
+
+private:
+  static const size_t batchSize = 4096;
+  Mode mode;
+  size_t capacity;
+  TraceWriter* writer;
+  uint32_t id;
+  vector<TracePoint> points;
+  vector<TracePoint> batch;
+  uint64_t stride = 1, untilNext = 1;
+  uint64_t lastIteration = 0, count = 0;
+  double sum = 0;
+  double best = numeric_limits<double>::infinity();
+
+  void keep(uint64_t iteration, double distance)
+  {
+    untilNext = stride;
+    if (writer != nullptr)
+    {
+      batch.push_back({iteration, distance});
+      if (batch.size() == batchSize)
+      {
+        writer->submit(id, batch);
+      }
+    }
+    if (mode == DECIMATED && points.size() == capacity)
+    {
+      // Keep every other point. The next one due is a new stride after the last kept
+      // point, which is an old stride after this one.
+      for (size_t i = 0; i < capacity / 2; ++i)
+      {
+        points[i] = points[2 * i + 1];
+      }
+      points.resize(capacity / 2);
+      untilNext = stride;
+      stride *= 2;
+      return;
+    }
+    points.push_back({iteration, distance});
+  }
+};
+
+void printDistances(const ConvergenceTrace& trace)
+{
+  const vector<TracePoint>& points = trace.getPoints();
+  for (const auto& point : points)
+  {
+    if (!trace.isComplete())
+    {
+      cout << point.iteration + 1 << ": ";
+    }
+    cout << point.distance;
+    if(&point != &points.back())
+    {
+      cout << ", ";
+    }
+  }
+  cout << endl;
+  cout << "Average Distance: " << trace.averageDistance() << endl;
+}
+// Small, fast random number generator (xoshiro256**). Each thread or trajectory
+// gets its own, seeded from the run's seed and a stream number, so runs repeat
+// exactly for a given seed and nothing is shared between threads.
+class Rng
+{
+public:
+  explicit Rng(uint64_t seed, uint64_t stream = 0)
+  {
+    // splitmix64 spreads the seed over the whole state
+    uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+    for (uint64_t& word : state)
+    {
+      x += 0x9E3779B97F4A7C15ull;
+      uint64_t z = x;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      word = z ^ (z >> 31);
+    }
+  }
+
+  uint64_t next()
+  {
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+  }
+
+  // Uniform integer in [0, bound) without modulo bias (Lemire's multiply and reject)
+  uint32_t below(uint32_t bound)
+  {
+    uint64_t product = (next() >> 32) * bound;
+    uint32_t low = static_cast<uint32_t>(product);
+    if (low < bound)
+    {
+      uint32_t threshold = -bound % bound;
+      while (low < threshold)
+      {
+        product = (next() >> 32) * bound;
+        low = static_cast<uint32_t>(product);
+      }
+    }
+    return product >> 32;
+  }
+
+  // Uniform double in [0, 1)
+  double uniform() { return (next() >> 11) * 0x1.0p-53; }
+
+private:
+  uint64_t state[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+};
+
+// Function to generate a random initial route
+Tour generateRandomRoute(size_t cities, Rng& rng)
+{
+  Tour route;
+  route.order.resize(cities + 1);
+  route.position.resize(cities);
+  for (size_t i = 0; i < cities; ++i)
+  {
+    route.order[i] = i;
+  }
+  // Fisher-Yates over order[1..cities - 2]
+  for (size_t i = cities - 2; i > 1 && cities > 2; --i)
+  {
+    swap(route.order[i], route.order[1 + rng.below(i)]);
+  }
+  route.order[cities] = route.order[0];
+  route.updatePositions(0, cities - 1);
+  return route;
+}
+
+// Function to calculate total distance for a given route
+double calculateRouteDistance(const Tour& route, const DistanceMatrix& distanceMatrix)
+{
+  double totalDistance = 0;
+  for (size_t i = 0; i < route.size() - 1; ++i)
+  {
+    totalDistance += distanceMatrix(route[i], route[i + 1]);
+  }
+  return totalDistance;
+}
+
+// Change in route distance if the campuses at positions i and j were swapped.
+// Only the (up to) four edges touching i and j are looked at, so this is O(1).
+// Swapping back is the same move, so the reverse move scores -swapDelta(...).
+double swapDelta(const Tour& route, size_t i, size_t j, const DistanceMatrix& distanceMatrix)
+{
+  if (i == j)
+  {
+    return 0;
+  }
+  if (i > j)
+  {
+    swap(i, j);
+  }
+  uint32_t a = route[i - 1], b = route[i], c = route[i + 1];
+  uint32_t d = route[j - 1], e = route[j], f = route[j + 1];
+  if (j == i + 1)
+  {
+    // a->b->e->f becomes a->e->b->f
+    return distanceMatrix(a, e) + distanceMatrix(e, b) + distanceMatrix(b, f)
+         - distanceMatrix(a, b) - distanceMatrix(b, e) - distanceMatrix(e, f);
+  }
+  return distanceMatrix(a, e) + distanceMatrix(e, c) + distanceMatrix(d, b) + distanceMatrix(b, f)
+       - distanceMatrix(a, b) - distanceMatrix(b, c) - distanceMatrix(d, e) - distanceMatrix(e, f);
+}
+
+// Change in route distance if the segment route[i..j] were reversed. Only the two
+// boundary edges change (assumes a symmetric distance matrix), so this is O(1).
+double reverseDelta(const Tour& route, size_t i, size_t j, const DistanceMatrix& distanceMatrix)
+{
+  if (i > j)
+  {
+    swap(i, j);
+  }
+  uint32_t a = route[i - 1], b = route[i];
+  uint32_t e = route[j], f = route[j + 1];
+  return distanceMatrix(a, e) + distanceMatrix(b, f) - distanceMatrix(a, b) - distanceMatrix(e, f);
+}
+
+// 2-d tree over city coordinates for nearest neighbour queries. It is stored implicitly:
+// the median of order[lo, hi) on the split axis sits in the middle and the two halves
+// either side of it are its subtrees. The axis alternates x, y with depth.
+class KdTree
+{
+public:
+  KdTree(const vector<double>& x, const vector<double>& y) : x(x), y(y), order(x.size())
+  {
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+      order[i] = i;
+    }
+    build(0, order.size(), 0);
+  }
+
+  // The k cities closest to city (not counting itself) into best as (squared distance, city), closest first
+  void nearest(int city, size_t k, vector<pair<double, int>>& best) const
+  {
+    best.clear();
+    search(0, order.size(), 0, city, k, best);
+  }
+
+private:
+  const vector<double>& x;
+  const vector<double>& y;
+  vector<int> order;
+
+  double coordinate(int city, int axis) const { return axis == 0 ? x[city] : y[city]; }
+
+  void build(size_t lo, size_t hi, int axis)
+  {
+    if (hi - lo <= 1)
+    {
+      return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    nth_element(order.begin() + lo, order.begin() + mid, order.begin() + hi,
+                [&](int a, int b) { return coordinate(a, axis) < coordinate(b, axis); });
+    build(lo, mid, 1 - axis);
+    build(mid + 1, hi, 1 - axis);
+  }
+
+  void search(size_t lo, size_t hi, int axis, int city, size_t k, vector<pair<double, int>>& best) const
+  {
+    if (lo >= hi)
+    {
+      return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    int point = order[mid];
+    if (point != city)
+    {
+      double dx = x[city] - x[point];
+      double dy = y[city] - y[point];
+      double distance = dx * dx + dy * dy;
+      if (best.size() < k || distance < best.back().first)
+      {
+        if (best.size() == k)
+        {
+          best.pop_back();
+        }
+        best.insert(upper_bound(best.begin(), best.end(), make_pair(distance, point)), make_pair(distance, point));
+      }
+    }
+    // The side of the split holding city first; the other only if it can still hold something closer
+    double offset = coordinate(city, axis) - coordinate(point, axis);
+    bool left = offset < 0;
+    search(left ? lo : mid + 1, left ? mid : hi, 1 - axis, city, k, best);
+    if (best.size() < k || offset * offset < best.back().first)
+    {
+      search(left ? mid + 1 : lo, left ? hi : mid, 1 - axis, city, k, best);
+    }
+  }
+};
+
+// The k nearest other cities of every city, closest first. Local search only
+// tries to connect a city to one of these, which keeps each move check O(k).
+// With coordinates they come from a k-d tree in O(n log n); explicit weights have no
+// geometry, so each city scans all the others.
+struct CandidateLists
+{
+  size_t k = 0;
+  vector<int> neighbours; // k entries per city
+
+  CandidateLists(const DistanceMatrix& distanceMatrix, size_t maxNeighbours)
+  {
+    size_t n = distanceMatrix.size();
+    k = min(maxNeighbours, n - 1);
+    neighbours.resize(n * k);
+    if (distanceMatrix.hasCoordinates())
+    {
+      // Rounding to integers keeps the order of the exact distances, so the tree's lists
+      // are the nearest under the matrix too
+      KdTree tree(distanceMatrix.xCoordinates(), distanceMatrix.yCoordinates());
+      vector<pair<double, int>> best;
+      for (size_t city = 0; city < n; ++city)
+      {
+        tree.nearest(city, k, best);
+        for (size_t i = 0; i < k; ++i)
+        {
+          neighbours[city * k + i] = best[i].second;
+        }
+      }
+      return;
+    }
+    vector<int> others(n);
+    for (size_t city = 0; city < n; ++city)
+    {
+      size_t count = 0;
+      for (size_t other = 0; other < n; ++other)
+      {
+        if (other != city)
+        {
+          others[count++] = other;
+        }
+      }
+      auto closer = [&](int x, int y) { return distanceMatrix(city, x) < distanceMatrix(city, y); };
+      partial_sort(others.begin(), others.begin() + k, others.begin() + count, closer);
+      copy(others.begin(), others.begin() + k, neighbours.begin() + city * k);
+    }
+  }
+
+  const int* of(int city) const { return neighbours.data() + city * k; }
+};
+
+// 2-opt and Or-opt local search over a route. Moves are only tried towards
+// candidate neighbours, and a city whose neighbourhood has nothing to offer is
+// skipped (its don't-look bit is set) until a move changes one of its edges.
+// The route's position index means every move is found in O(k); applying a move
+// reverses or rotates part of the route in place.
+// Like reverseDelta, this assumes a symmetric distance matrix.
+class LocalSearch
+{
+public:
+  LocalSearch(const DistanceMatrix& distanceMatrix, const CandidateLists& candidates) : distanceMatrix(distanceMatrix), candidates(candidates) {}
+
+  // Takes a copy of route (closed, route.front() == route.back()) and marks every city for checking
+  void setRoute(const Tour& newRoute)
+  {
+    route = newRoute;
+    n = route.size() - 1;
+    inQueue.assign(distanceMatrix.size(), false);
+    queue.resize(distanceMatrix.size());
+    queueHead = queueSize = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      activate(city(i));
+    }
+  }
+
+  const Tour& getRoute() const { return route; }
+
+  // Applies improving moves until every city's don't-look bit is set. Returns the change in distance.
+  double optimise()
+  {
+    double totalDelta = 0;
+    while (queueSize > 0)
+    {
+      int a = queue[queueHead];
+      queueHead = (queueHead + 1) % queue.size();
+      --queueSize;
+      inQueue[a] = false;
+      double delta;
+      while ((delta = improveCity(a)) < 0)
+      {
+        totalDelta += delta;
+      }
+    }
+    return totalDelta;
+  }
+
+  // Swaps the cities at positions i and j (never 0 or n) and queues everything around them for checking
+  double swapCities(size_t i, size_t j)
+  {
+    double delta = swapDelta(route, i, j, distanceMatrix);
+    route.swapPositions(i, j);
+    for (size_t p : {i - 1, i, i + 1, j - 1, j, j + 1})
+    {
+      activate(city(p));
+    }
+    return delta;
+  }
+
+private:
+  static constexpr double epsilon = 1e-9;
+  const DistanceMatrix& distanceMatrix;
+  const CandidateLists& candidates;
+  Tour route;
+  size_t n = 0;
+  vector<bool> inQueue;
+  vector<int> queue; // ring buffer of cities whose don't-look bit is clear
+  size_t queueHead = 0, queueSize = 0;
+
+  int city(size_t i) const { return route[i]; }
+  double distance(int a, int b) const { return distanceMatrix(a, b); }
+
+  void activate(int c)
+  {
+    if (!inQueue[c])
+    {
+      inQueue[c] = true;
+      queue[(queueHead + queueSize) % queue.size()] = c;
+      ++queueSize;
+    }
+  }
+
+  // Removes edges (i, i + 1) and (j, j + 1) by reversing route[i + 1..j]
+  void applyTwoOpt(size_t i, size_t j)
+  {
+    if (i > j)
+    {
+      swap(i, j);
+    }
+    reverse(route.order.begin() + i + 1, route.order.begin() + j + 1);
+    route.updatePositions(i + 1, j);
+  }
+
+  // Moves the length cities starting at position start so they sit between positions after and after + 1
+  void applyOrOpt(size_t start, size_t length, size_t after, bool reversed)
+  {
+    size_t first, last;
+    if (after > start)
+    {
+      rotate(route.order.begin() + start, route.order.begin() + start + length, route.order.begin() + after + 1);
+      first = start;
+      last = after;
+      if (reversed)
+      {
+        reverse(route.order.begin() + after + 1 - length, route.order.begin() + after + 1);
+      }
+    }
+    else
+    {
+      rotate(route.order.begin() + after + 1, route.order.begin() + start, route.order.begin() + start + length);
+      first = after + 1;
+      last = start + length - 1;
+      if (reversed)
+      {
+        reverse(route.order.begin() + after + 1, route.order.begin() + after + 1 + length);
+      }
+    }
+    route.updatePositions(first, last);
+  }
+
+  // Looks for one improving move around city a and applies it. Returns its change in distance, or 0.
+  double improveCity(int a)
+  {
+    const int* neighbours = candidates.of(a);
+    size_t p = route.position[a];
+
+    // 2-opt with a's successor edge (p, p + 1)
+    int b = city(p + 1);
+    for (size_t k = 0; k < candidates.k; ++k)
+    {
+      int c = neighbours[k];
+      if (distance(a, c) >= distance(a, b))
+      {
+        break;
+      }
+      size_t q = route.position[c];
+      if (c == b || city(q + 1) == a)
+      {
+        continue;
+      }
+      double delta = reverseDelta(route, min(p, q) + 1, max(p, q), distanceMatrix);
+      if (delta < -epsilon)
+      {
+        activate(a), activate(b), activate(c), activate(city(q + 1));
+        applyTwoOpt(p, q);
+        return delta;
+      }
+    }
+
+    // 2-opt with a's predecessor edge (p - 1, p). Position 0 is also position n.
+    size_t pp = p == 0 ? n : p;
+    b = city(pp - 1);
+    for (size_t k = 0; k < candidates.k; ++k)
+    {
+      int c = neighbours[k];
+      if (distance(a, c) >= distance(b, a))
+      {
+        break;
+      }
+      size_t q = route.position[c] == 0 ? n : route.position[c];
+      if (c == b || city(q - 1) == a)
+      {
+        continue;
+      }
+      double delta = reverseDelta(route, min(pp, q), max(pp, q) - 1, distanceMatrix);
+      if (delta < -epsilon)
+      {
+        activate(a), activate(b), activate(c), activate(city(q - 1));
+        applyTwoOpt(pp - 1, q - 1);
+        return delta;
+      }
+    }
+
+    // Or-opt: move the segment of 1 to 3 cities starting at a next to one of a's neighbours
+    for (size_t length = 1; length <= 3; ++length)
+    {
+      if (p == 0 || p + length > n)
+      {
+        break;
+      }
+      int s2 = city(p + length - 1);
+      int before = city(p - 1), after = city(p + length);
+      double removed = distance(before, a) + distance(s2, after) - distance(before, after);
+      for (size_t k = 0; k < candidates.k; ++k)
+      {
+        int c = neighbours[k];
+        if (distance(a, c) >= removed)
+        {
+          break;
+        }
+        size_t q = route.position[c];
+        if (q >= p && q < p + length)
+        {
+          continue;
+        }
+        // c -> a..s2 -> succ(c)
+        if (q != p - 1)
+        {
+          int d = city(q + 1);
+          double delta = distance(c, a) + distance(s2, d) - distance(c, d) - removed;
+          if (delta < -epsilon)
+          {
+            activate(before), activate(after), activate(a), activate(s2), activate(c), activate(d);
+            applyOrOpt(p, length, q, false);
+            return delta;
+          }
+        }
+        // pred(c) -> s2..a -> c
+        size_t qq = q == 0 ? n : q;
+        if (qq != p + length)
+        {
+          int e = city(qq - 1);
+          double delta = distance(e, s2) + distance(a, c) - distance(e, c) - removed;
+          if (delta < -epsilon)
+          {
+            activate(before), activate(after), activate(a), activate(s2), activate(c), activate(e);
+            applyOrOpt(p, length, qq - 1, true);
+            return delta;
+          }
+        }
+      }
+    }
+    return 0;
+  }
+};
+
+// Function to perform perturbation. Returns the change in distance.
+double perturbation(LocalSearch& search, Rng& rng)
 {
-  for (const auto& visit : route)
+  uint32_t size = search.getRoute().size();
+  size_t i = rng.below(size-2)+1;
+  size_t j = rng.below(size-2)+1;
+  return search.swapCities(i, j);
+}
+
+// Best route found so far by any thread. The distance is atomic so threads can
+// check it without locking; the lock is only taken to swap in a better route.
+class SharedIncumbent
+{
+public:
+  double distance() const { return bestDistance.load(memory_order_acquire); }
+
+  // Makes route the incumbent if it is better. Returns whether it was.
+  bool offer(const Tour& route, double routeDistance)
   {
-    cout << visit.campusName;
-    if (&visit != &route.back())
+    if (routeDistance >= distance())
     {
-      cout << "->";
+      return false;
+    }
+    lock_guard<mutex> guard(lock);
+    if (routeDistance >= bestDistance.load(memory_order_relaxed))
+    {
+      return false;
     }
+    bestRoute = route;
+    bestDistance.store(routeDistance, memory_order_release);
+    return true;
   }
-  cout << endl;
+
+  // Copies the incumbent into route if it is shorter than threshold. Returns its distance, or threshold if nothing was copied.
+  double copyIfBetter(Tour& route, double threshold) const
+  {
+    if (distance() >= threshold)
+    {
+      return threshold;
+    }
+    lock_guard<mutex> guard(lock);
+    route = bestRoute;
+    return bestDistance.load(memory_order_relaxed);
+  }
+
+private:
+  atomic<double> bestDistance{numeric_limits<double>::infinity()};
+  mutable mutex lock;
+  Tour bestRoute;
+};
+
+// How one trajectory of a parallel run shares its progress with the others.
+// Every checkInterval iterations a trajectory publishes its best route, and if the
+// incumbent is more than restartGap (a fraction) shorter it restarts from the incumbent.
+struct Cooperation
+{
+  SharedIncumbent* incumbent = nullptr;
+  int checkInterval = 1000;
+  double restartGap = -1; // < 0 never restarts
+};
+
+// Publishes bestRoute to the incumbent and returns true if the trajectory should restart from it
+bool shareProgress(const Cooperation& cooperation, const Tour& bestRoute, double bestDistance)
+{
+  if (cooperation.incumbent == nullptr)
+  {
+    return false;
+  }
+  cooperation.incumbent->offer(bestRoute, bestDistance);
+  return cooperation.restartGap >= 0 && cooperation.incumbent->distance() < bestDistance * (1 - cooperation.restartGap);
 }
-void printDistances(const vector<double>& distances)
+
+// When a search stops: after maxIterations, once deadline has passed, or as soon as
+// the best distance is at most targetDistance, whichever comes first. The clock is
+// only read every checkEvery iterations to keep it off the hot loop.
+struct StopCondition
 {
-  double totalDistance = 0;
-  for (const auto& distance : distances)
+  long long maxIterations;
+  chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+  int checkEvery = 256;
+  double targetDistance = -numeric_limits<double>::infinity();
+
+  explicit StopCondition(long long maxIterations) : maxIterations(maxIterations) {}
+
+  bool done(long long iteration) const
   {
-    totalDistance += distance;
-    cout << distance;
-    if(&distance != &distances.back())
+    if (iteration >= maxIterations)
     {
-      cout << ", ";
+      return true;
     }
-    else
+    return iteration % checkEvery == 0 && deadline != chrono::steady_clock::time_point::max() && chrono::steady_clock::now() >= deadline;
+  }
+};
+
+// Temperature for simulated annealing, updated in place once per iteration.
+// GEOMETRIC multiplies by rate every iteration.
+// LUNDY_MEES sets T = T / (1 + beta T), which cools quickly while hot and slowly near the end.
+// ADAPTIVE looks at the acceptance rate every window iterations and warms up or cools down
+// towards targetAcceptance. If reheatAfter windows pass without a new best it reheats to ten
+// times the current temperature (at most the initial one). It needs no iteration count.
+// GEOMETRIC and LUNDY_MEES are tied to an iteration count; for a run that only has a
+// deadline, followDeadline moves them onto the fraction of the time used instead.
+class CoolingSchedule
+{
+public:
+  enum Type
+  {
+    GEOMETRIC,
+    LUNDY_MEES,
+    ADAPTIVE
+  };
+
+  static CoolingSchedule geometric(double initialTemperature, double rate)
+  {
+    CoolingSchedule schedule(GEOMETRIC, initialTemperature);
+    schedule.factor = rate;
+    return schedule;
+  }
+
+  // beta is chosen so the temperature reaches finalTemperature after iterations updates
+  static CoolingSchedule lundyMees(double initialTemperature, double finalTemperature, long long iterations)
+  {
+    CoolingSchedule schedule(LUNDY_MEES, initialTemperature);
+    schedule.factor = (initialTemperature - finalTemperature) / (max(iterations, 1LL) * initialTemperature * finalTemperature);
+    return schedule;
+  }
+
+  static CoolingSchedule adaptive(double initialTemperature, double targetAcceptance = 0.05, int window = 100, int reheatAfter = 100)
+  {
+    CoolingSchedule schedule(ADAPTIVE, initialTemperature);
+    schedule.targetAcceptance = targetAcceptance;
+    schedule.window = window;
+    schedule.reheatAfter = reheatAfter;
+    return schedule;
+  }
+
+  double temperature() const { return current; }
+
+  // From now on GEOMETRIC and LUNDY_MEES set the temperature from the fraction f of
+  // [start, deadline] used: T0 (Tf/T0)^f and T0 / (1 + f (T0/Tf - 1)), the curves they follow
+  // over an iteration count, reaching finalTemperature at the deadline. ADAPTIVE is unchanged.
+  void followDeadline(chrono::steady_clock::time_point start, chrono::steady_clock::time_point deadline, double finalTemperature)
+  {
+    timed = true;
+    budgetStart = start;
+    budgetEnd = deadline;
+    final = finalTemperature;
+  }
+
+  // accepted: whether this iteration's move was taken. improvedBest: whether it gave a new best route.
+  void update(bool accepted, bool improvedBest)
+  {
+    if (timed && type != ADAPTIVE)
     {
-      cout << endl;
+      // Reading the clock costs about as much as an iteration, so only every clockInterval
+      if (++sinceClock == clockInterval)
+      {
+        sinceClock = 0;
+        double used = chrono::duration<double>(chrono::steady_clock::now() - budgetStart).count();
+        double fraction = min(1.0, max(0.0, used / chrono::duration<double>(budgetEnd - budgetStart).count()));
+        current = type == GEOMETRIC ? initial * pow(final / initial, fraction) : initial / (1 + fraction * (initial / final - 1));
+      }
+      return;
+    }
+    switch (type)
+    {
+    case GEOMETRIC:
+      current *= factor;
+      break;
+    case LUNDY_MEES:
+      current = current / (1 + factor * current);
+      break;
+    case ADAPTIVE:
+      acceptedInWindow += accepted;
+      windowsWithoutBest = improvedBest ? 0 : windowsWithoutBest;
+      if (++iterationsInWindow == window)
+      {
+        double acceptance = static_cast<double>(acceptedInWindow) / window;
+        current *= acceptance > targetAcceptance ? 0.95 : 1.05;
+        if (++windowsWithoutBest >= reheatAfter)
+        {
+          current = min(current * 10, initial);
+          windowsWithoutBest = 0;
+        }
+        iterationsInWindow = acceptedInWindow = 0;
+      }
+      break;
     }
   }
-  cout << "Average Distance: " << totalDistance / distances.size() << endl;
-}
-// Function to generate a random initial route
-vector<CampusVisit> generateRandomRoute(const vector<CampusVisit>& campuses)
+
+private:
+  Type type;
+  double initial, current;
+  double factor = 1;
+  double targetAcceptance = 0;
+  int window = 1, reheatAfter = 0;
+  int iterationsInWindow = 0, acceptedInWindow = 0, windowsWithoutBest = 0;
+  static const int clockInterval = 64;
+  bool timed = false;
+  chrono::steady_clock::time_point budgetStart, budgetEnd;
+  double final = 0;
+  int sinceClock = 0;
+
+  CoolingSchedule(Type type, double initialTemperature) : type(type), initial(initialTemperature), current(initialTemperature) {}
+};
+
+// Function to perform simulated annealing
+pair<Tour, ConvergenceTrace> simulatedAnnealing(size_t cities, const DistanceMatrix& distanceMatrix, CoolingSchedule schedule, const StopCondition& stop, Rng& rng, ConvergenceTrace trace = ConvergenceTrace(), const Cooperation& cooperation = Cooperation())
 {
-  vector<CampusVisit> route = campuses;
-  shuffle(route.begin() + 1, route.end() - 1, mt19937(random_device{}()));
-  route.push_back(route.front());
-  return route;
+  Tour currentRoute = generateRandomRoute(cities, rng);
+  Tour bestRoute = currentRoute;
+  double currentDistance = calculateRouteDistance(currentRoute, distanceMatrix);
+  double bestDistance = currentDistance;
+
+  for (long long i = 0; !stop.done(i); ++i)
+  {
+    double temperature = schedule.temperature();
+    size_t a = rng.below(currentRoute.size()-2)+1;
+    size_t b = rng.below(currentRoute.size()-2)+1;
+    double delta = swapDelta(currentRoute, a, b, distanceMatrix);
+    bool accepted = delta < 0 || exp(-delta / temperature) > rng.uniform();
+    bool improvedBest = false;
+    if (accepted)
+    {
+      currentRoute.swapPositions(a, b);
+      currentDistance += delta;
+      if (currentDistance < bestDistance)
+      {
+        bestRoute = currentRoute;
+        bestDistance = currentDistance;
+        improvedBest = true;
+      }
+    }
+    schedule.update(accepted, improvedBest);
+    if ((i + 1) % cooperation.checkInterval == 0 && shareProgress(cooperation, bestRoute, bestDistance))
+    {
+      bestDistance = cooperation.incumbent->copyIfBetter(bestRoute, bestDistance);
+      currentRoute = bestRoute;
+      currentDistance = bestDistance;
+    }
+    trace.record(i, bestDistance);
+    if (bestDistance <= stop.targetDistance)
+    {
+      break;
+    }
+  }
+  shareProgress(cooperation, bestRoute, bestDistance);
+  trace.finish();
+
+  return make_pair(bestRoute, trace);
 }
 
-// Function to calculate total distance for a given route
-double calculateRouteDistance(const vector<CampusVisit>& route, const double distanceMatrix[][5])
+// Function to perform iterated local search
+pair<Tour, ConvergenceTrace> iteratedLocalSearch(const Tour& initialRoute, const DistanceMatrix& distanceMatrix, const CandidateLists& candidates, const StopCondition& stop, Rng& rng, ConvergenceTrace trace = ConvergenceTrace(), const Cooperation& cooperation = Cooperation())
 {
-  double totalDistance = 0;
-  for (size_t i = 0; i < route.size() - 1; ++i)
+  LocalSearch search(distanceMatrix, candidates);
+  search.setRoute(initialRoute);
+  Tour bestRoute = initialRoute;
+  double currentDistance = calculateRouteDistance(initialRoute, distanceMatrix);
+  double bestDistance = currentDistance;
+
+  for (long long i = 0; !stop.done(i); ++i)
   {
-    totalDistance += distanceMatrix[route[i].campusId][route[i + 1].campusId];
+    currentDistance += search.optimise();
+    if (currentDistance < bestDistance - 1e-9)
+    {
+      bestRoute = search.getRoute();
+      bestDistance = currentDistance;
+    }
+    if ((i + 1) % cooperation.checkInterval == 0 && shareProgress(cooperation, bestRoute, bestDistance))
+    {
+      bestDistance = cooperation.incumbent->copyIfBetter(bestRoute, bestDistance);
+      search.setRoute(bestRoute);
+      currentDistance = bestDistance;
+    }
+    trace.record(i, bestDistance);
+    if (bestDistance <= stop.targetDistance)
+    {
+      break;
+    }
+    currentDistance += perturbation(search, rng);
   }
-  return totalDistance;
+  shareProgress(cooperation, bestRoute, bestDistance);
+  trace.finish();
+
+  return make_pair(bestRoute, trace);
 }
 
-vector<CampusVisit> localSearch(vector<CampusVisit> route, const double distanceMatrix[][5])
+typedef pair<Tour, ConvergenceTrace> SearchResult;
+
+// Runs trajectories independent searches on a pool of threads workers. Each worker
+// takes the next trajectory number until there are none left and calls
+// solve(trajectory, cooperation). Returns the results in trajectory order.
+template <typename Solve>
+vector<SearchResult> multiStart(int trajectories, int threads, SharedIncumbent& incumbent, double restartGap, Solve solve)
 {
-  bool improvement = true;
-  while (improvement)
+  Cooperation cooperation;
+  cooperation.incumbent = &incumbent;
+  cooperation.restartGap = restartGap;
+  vector<SearchResult> results(trajectories);
+  atomic<int> nextTrajectory(0);
+  vector<thread> workers;
+  for (int t = 0; t < min(threads, trajectories); ++t)
   {
-    improvement = false;
-    for (size_t i = 1; i < route.size() - 2; ++i) // Exclude first and last elements from swapping
+    workers.emplace_back([&]()
     {
-      vector<CampusVisit> newRoute = route;
-      swap(newRoute[i], newRoute[i + 1]); // Swap consecutive campuses
-      if (calculateRouteDistance(newRoute, distanceMatrix) < calculateRouteDistance(route, distanceMatrix))
+      for (int i = nextTrajectory++; i < trajectories; i = nextTrajectory++)
       {
-        route = newRoute;
-        improvement = true;
+        results[i] = solve(i, cooperation);
       }
-    }
+    });
   }
-  return route;
+  for (thread& worker : workers)
+  {
+    worker.join();
+  }
+  return results;
 }
 
-// Function to perform perturbation
-vector<CampusVisit> perturbation(vector<CampusVisit> route)
+// The result with the shortest best route
+const SearchResult& bestResult(const vector<SearchResult>& results)
 {
-  swap(route[(rand() % (route.size()-2))+1], route[(rand() % (route.size()-2))+1]);
-  return route;
+  size_t best = 0;
+  for (size_t i = 1; i < results.size(); ++i)
+  {
+    if (results[i].second.bestDistance() < results[best].second.bestDistance())
+    {
+      best = i;
+    }
+  }
+  return results[best];
 }
 
-// Function to perform simulated annealing
-pair<vector<CampusVisit>, vector<double>> simulatedAnnealing(const vector<CampusVisit>& campuses, const double distanceMatrix[][5], double initialTemperature, double coolingRate, int maxIterations)
+// Lets a fixed number of threads wait for each other. Can be reused straight away.
+class Barrier
+{
+public:
+  explicit Barrier(int count) : count(count) {}
+
+  void wait()
+  {
+    unique_lock<mutex> guard(lock);
+    int arrivedGeneration = generation;
+    if (++waiting == count)
+    {
+      waiting = 0;
+      ++generation;
+      released.notify_all();
+      return;
+    }
+    released.wait(guard, [&]() { return generation != arrivedGeneration; });
+  }
+
+private:
+  int count;
+  int waiting = 0;
+  int generation = 0;
+  mutex lock;
+  condition_variable released;
+};
+
+// One route of a parallel tempering run
+struct Replica
 {
-  vector<CampusVisit> currentRoute = generateRandomRoute(campuses);
-  vector<CampusVisit> bestRoute = currentRoute;
-  vector<double> bestDistances;
+  Tour route;
+  double distance;
+};
+
+// Replica-exchange (parallel tempering) annealing. replicas routes are kept at fixed
+// temperatures spaced geometrically from maxTemperature down to minTemperature,
+// each annealed on its own thread. Every exchangeInterval moves the threads meet and
+// neighbouring temperatures try to swap routes, so good routes found while hot sink
+// to the cold end while the hot end keeps exploring. Neighbour pairs alternate
+// between (0,1),(2,3).. and (1,2),(3,4).. on successive exchanges.
+// Replica thread r draws from stream r of seed. trace gets the best distance over
+// all replicas after each exchange.
+pair<Tour, ConvergenceTrace> parallelTempering(size_t cities, const DistanceMatrix& distanceMatrix, int replicas, double maxTemperature, double minTemperature, const StopCondition& stop, int exchangeInterval, uint64_t seed, ConvergenceTrace trace = ConvergenceTrace())
+{
+  vector<double> temperatures(replicas);
+  for (int r = 0; r < replicas; ++r)
+  {
+    temperatures[r] = replicas == 1 ? minTemperature : maxTemperature * pow(minTemperature / maxTemperature, static_cast<double>(r) / (replicas - 1));
+  }
+  // states[r] is the replica currently at temperatures[r]; exchanges swap the pointers
+  vector<Replica> storage(replicas);
+  vector<Replica*> states(replicas);
+  vector<Rng> rngs;
+  for (int r = 0; r < replicas; ++r)
+  {
+    rngs.emplace_back(seed, r);
+    storage[r].route = generateRandomRoute(cities, rngs[r]);
+    storage[r].distance = calculateRouteDistance(storage[r].route, distanceMatrix);
+    states[r] = &storage[r];
+  }
+  // Best route seen by each thread, whichever replica it was annealing at the time
+  vector<Replica> bests = storage;
 
-  for (int i = 0; i < maxIterations; ++i)
+  // Thread 0 checks the stop condition at each exchange so every thread stops together
+  bool finished = false;
+  Barrier barrier(replicas);
+  auto worker = [&](int r)
   {
-    double temperature = initialTemperature * pow(coolingRate, i);
-    vector<CampusVisit> neighbor = currentRoute;
-    swap(neighbor[(rand() % (neighbor.size()-2))+1], neighbor[(rand() % (neighbor.size()-2))+1]);
-    if (calculateRouteDistance(neighbor, distanceMatrix) < calculateRouteDistance(currentRoute, distanceMatrix) || exp((calculateRouteDistance(currentRoute, distanceMatrix) - calculateRouteDistance(neighbor, distanceMatrix)) / temperature) > static_cast<double>(rand()) / RAND_MAX)
+    Replica& best = bests[r];
+    Rng& rng = rngs[r];
+    for (long long round = 0; !finished; ++round)
     {
-      currentRoute = neighbor;
-      if (calculateRouteDistance(currentRoute, distanceMatrix) < calculateRouteDistance(bestRoute, distanceMatrix))
+      Replica& state = *states[r];
+      Tour& route = state.route;
+      long long moves = min<long long>(exchangeInterval, stop.maxIterations - round * exchangeInterval);
+      for (long long i = 0; i < moves; ++i)
       {
-        bestRoute = currentRoute;
+        size_t a = rng.below(route.size()-2)+1;
+        size_t b = rng.below(route.size()-2)+1;
+        double delta = swapDelta(route, a, b, distanceMatrix);
+        if (delta < 0 || exp(-delta / temperatures[r]) > rng.uniform())
+        {
+          route.swapPositions(a, b);
+          state.distance += delta;
+          if (state.distance < best.distance)
+          {
+            best = state;
+          }
+        }
       }
+      barrier.wait();
+      if (r == 0)
+      {
+        for (int i = round % 2; i + 1 < replicas; i += 2)
+        {
+          double exponent = (1 / temperatures[i] - 1 / temperatures[i + 1]) * (states[i]->distance - states[i + 1]->distance);
+          if (exponent >= 0 || exp(exponent) > rng.uniform())
+          {
+            swap(states[i], states[i + 1]);
+          }
+        }
+        double bestDistance = bests[0].distance;
+        for (const Replica& threadBest : bests)
+        {
+          bestDistance = min(bestDistance, threadBest.distance);
+        }
+        long long iterations = round * exchangeInterval + moves;
+        trace.record(iterations - 1, bestDistance);
+        finished = iterations >= stop.maxIterations || bestDistance <= stop.targetDistance || chrono::steady_clock::now() >= stop.deadline;
+      }
+      barrier.wait();
     }
-    bestDistances.push_back(calculateRouteDistance(bestRoute, distanceMatrix));
+  };
+  vector<thread> threads;
+  for (int r = 0; r < replicas; ++r)
+  {
+    threads.emplace_back(worker, r);
   }
-
-  return make_pair(bestRoute, bestDistances);
+  for (thread& t : threads)
+  {
+    t.join();
+  }
+  size_t best = 0;
+  for (size_t r = 1; r < bests.size(); ++r)
+  {
+    if (bests[r].distance < bests[best].distance)
+    {
+      best = r;
+    }
+  }
+  trace.finish();
+  return make_pair(bests[best].route, trace);
 }
 
-// Function to perform iterated local search
-pair<vector<CampusVisit>, vector<double>> iteratedLocalSearch(vector<CampusVisit> currentRoute, const double distanceMatrix[][5], int maxIterations)
+// Peak resident set size of the whole process so far, in kilobytes
+long peakRssKilobytes()
 {
-  vector<CampusVisit> bestRoute = currentRoute;
-  vector<double> bestDistances;
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
 
-  for (int i = 0; i < maxIterations; ++i)
+// Uniform random cities on a side x side square, or grouped into clusters Gaussian blobs when clusters > 0
+DistanceMatrix generateInstance(size_t cities, size_t clusters, uint64_t seed, double side = 10000)
+{
+  Rng rng(seed);
+  vector<double> x(cities), y(cities);
+  vector<double> centreX(clusters), centreY(clusters);
+  for (size_t c = 0; c < clusters; ++c)
+  {
+    centreX[c] = rng.uniform() * side;
+    centreY[c] = rng.uniform() * side;
+  }
+  for (size_t i = 0; i < cities; ++i)
   {
-    currentRoute = localSearch(currentRoute, distanceMatrix);
-    if (calculateRouteDistance(currentRoute, distanceMatrix) < calculateRouteDistance(bestRoute, distanceMatrix))
+    if (clusters == 0)
+    {
+      x[i] = rng.uniform() * side;
+      y[i] = rng.uniform() * side;
+    }
+    else
     {
-      bestRoute = currentRoute;
+      // Box-Muller around a random centre
+      size_t c = rng.below(clusters);
+      double radius = sqrt(-2 * log(1 - rng.uniform())) * side / 50;
+      double angle = 2 * M_PI * rng.uniform();
+      x[i] = centreX[c] + radius * cos(angle);
+      y[i] = centreY[c] + radius * sin(angle);
     }
-    bestDistances.push_back(calculateRouteDistance(bestRoute, distanceMatrix));
-    currentRoute = perturbation(currentRoute);
   }
+  return DistanceMatrix::fromCoordinates(x, y, true);
+}
+
+// Average nanoseconds to score one move of each kind on random positions of a random route
+pair<double, double> timeMoveEvaluation(const DistanceMatrix& distanceMatrix, Rng& rng)
+{
+  const int evaluations = 1 << 20;
+  Tour route = generateRandomRoute(distanceMatrix.size(), rng);
+  uint32_t movable = route.size() - 2;
+  vector<uint32_t> positions(2 * evaluations);
+  for (uint32_t& position : positions)
+  {
+    position = rng.below(movable) + 1;
+  }
+  double sink = 0;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < evaluations; ++i)
+  {
+    sink += swapDelta(route, positions[2 * i], positions[2 * i + 1], distanceMatrix);
+  }
+  auto middle = chrono::steady_clock::now();
+  for (int i = 0; i < evaluations; ++i)
+  {
+    sink += reverseDelta(route, positions[2 * i], positions[2 * i + 1], distanceMatrix);
+  }
+  auto end = chrono::steady_clock::now();
+  volatile double keep = sink;
+  (void)keep;
+  return make_pair(chrono::duration<double, nano>(middle - start).count() / evaluations,
+                   chrono::duration<double, nano>(end - middle).count() / evaluations);
+}
+
+// Runs ILS, SA and parallel tempering with fixed seeds over generated instances and the
+// given TSPLIB files, and prints one CSV row per instance and algorithm:
+// - iterations_per_sec and best_distance from a run with a fixed iteration budget
+// - ns_per_swap_eval / ns_per_2opt_eval from scoring random moves on the instance
+// - reference_distance, the same for every algorithm on an instance: the best of a long ILS
+//   run (max(10000, 10n) iterations) from its own seed
+// - target_distance, 70% of the way from the mean random tour to the reference, and
+//   time_to_target_ms from a second run that stops once it gets there (-1 if it is not
+//   reached within 2 seconds). The swap-move annealers close 70-95% of that gap in 2
+//   seconds on the generated instances, so the target is about the weakest one's reach.
+// - peak_rss_kb, the process peak so far. Instances are built one at a time in table
+//   order, so it only grows down the table.
+int runBenchmarks(const vector<string>& tsplibFiles)
+{
+  const uint64_t seed = 1;
+  // Each instance is only built when its turn comes, so the memory use of one does not hide another's
+  vector<pair<string, function<bool(DistanceMatrix&)>>> corpus;
+  for (size_t cities : {100, 1000, 5000})
+  {
+    corpus.emplace_back("uniform" + to_string(cities), [=](DistanceMatrix& matrix) { matrix = generateInstance(cities, 0, seed); return true; });
+  }
+  corpus.emplace_back("clustered1000", [=](DistanceMatrix& matrix) { matrix = generateInstance(1000, 10, seed); return true; });
+  for (const string& fileName : tsplibFiles)
+  {
+    corpus.emplace_back(fileName, [=](DistanceMatrix& matrix)
+    {
+      vector<string> names;
+      return loadTsplib(fileName, matrix, names);
+    });
+  }
+
+  cout << "instance,cities,layout,algorithm,seed,iterations,seconds,iterations_per_sec,best_distance,"
+          "ns_per_swap_eval,ns_per_2opt_eval,reference_distance,target_distance,time_to_target_ms,peak_rss_kb" << endl;
+  for (const auto& instance : corpus)
+  {
+    DistanceMatrix distanceMatrix;
+    if (!instance.second(distanceMatrix))
+    {
+      return 1;
+    }
+    size_t cities = distanceMatrix.size();
+    CandidateLists candidates(distanceMatrix, 10);
+    Rng moveRng(seed);
+    pair<double, double> moveCost = timeMoveEvaluation(distanceMatrix, moveRng);
+
+    Rng referenceRng(seed + 1);
+    double randomDistance = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+      randomDistance += calculateRouteDistance(generateRandomRoute(cities, referenceRng), distanceMatrix) / 8;
+    }
+    StopCondition referenceBudget(max<long long>(10000, 10 * cities));
+    Tour referenceStart = generateRandomRoute(cities, referenceRng);
+    double referenceDistance = iteratedLocalSearch(referenceStart, distanceMatrix, candidates, referenceBudget, referenceRng).second.bestDistance();
+    double targetDistance = referenceDistance + 0.3 * (randomDistance - referenceDistance);
+
+    // Each algorithm is run as solve(stop) with the same seed every time
+    vector<pair<string, function<pair<Tour, ConvergenceTrace>(const StopCondition&)>>> algorithms;
+    algorithms.emplace_back("ILS", [&](const StopCondition& stop)
+    {
+      Rng rng(seed);
+      Tour initialRoute = generateRandomRoute(cities, rng);
+      return iteratedLocalSearch(initialRoute, distanceMatrix, candidates, stop, rng);
+    });
+    algorithms.emplace_back("SA", [&](const StopCondition& stop)
+    {
+      Rng rng(seed);
+      return simulatedAnnealing(cities, distanceMatrix, CoolingSchedule::geometric(1000, 0.99999), stop, rng);
+    });
+    algorithms.emplace_back("SA-adaptive", [&](const StopCondition& stop)
+    {
+      Rng rng(seed);
+      return simulatedAnnealing(cities, distanceMatrix, CoolingSchedule::adaptive(1000), stop, rng);
+    });
+    algorithms.emplace_back("PT4", [&](const StopCondition& stop)
+    {
+      return parallelTempering(cities, distanceMatrix, 4, 1000, 1, stop, 1000, seed);
+    });
+
+    for (auto& algorithm : algorithms)
+    {
+      bool isIls = algorithm.first == "ILS";
+      StopCondition budget(isIls ? 1000 : 2000000);
+      auto start = chrono::steady_clock::now();
+      pair<Tour, ConvergenceTrace> result = algorithm.second(budget);
+      double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+      StopCondition toTarget(numeric_limits<long long>::max());
+      toTarget.checkEvery = isIls ? 1 : 256;
+      toTarget.targetDistance = targetDistance;
+      toTarget.deadline = chrono::steady_clock::now() + chrono::seconds(2);
+      auto targetStart = chrono::steady_clock::now();
+      pair<Tour, ConvergenceTrace> targetResult = algorithm.second(toTarget);
+      double targetMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - targetStart).count();
+      if (targetResult.second.bestDistance() > targetDistance)
+      {
+        targetMilliseconds = -1;
+      }
 
-  return make_pair(bestRoute, bestDistances);
+      const char* layouts[] = {"auto", "full", "triangular", "coordinates"};
+      cout << instance.first << ',' << cities << ',' << layouts[distanceMatrix.getLayout()] << ',' << algorithm.first << ',' << seed << ','
+           << result.second.iterations() << ',' << seconds << ',' << result.second.iterations() / seconds << ','
+           << result.second.bestDistance() << ',' << moveCost.first << ',' << moveCost.second << ','
+           << referenceDistance << ',' << targetDistance << ',' << targetMilliseconds << ',' << peakRssKilobytes() << endl;
+    }
+  }
+  return 0;
 }
 
-int main()
+// Usage: ./myprogram [tsplib file] [--threads N] [--starts N] [--restart gap] [--iterations N] [--tempering K]
+//                   [--trace improvements|decimated] [--trace-file file] [--seed S]
+//                   [--schedule geometric|lundy-mees|adaptive] [--time-limit ms]
+//        ./myprogram --bench [tsplib files...]
+// Without a file the five Pretoria campuses are used. --starts runs N trajectories
+// of each algorithm (one per thread by default) and keeps the best; --restart makes
+// a trajectory jump to the shared best route once it is more than gap (e.g. 0.05) behind.
+// --tempering also runs parallel tempering with K replicas over the same temperature range as SA.
+// --seed makes the run repeatable: trajectory t of each algorithm draws from stream t
+// of the seed (restarts from the shared route depend on timing, so leave --restart off).
+// --trace keeps every improvement or a fixed-size decimated summary (the default) of
+// each run's best distance; --trace-file also streams it to a CSV file (or binary if it ends in .bin).
+// --schedule picks SA's cooling schedule. --time-limit gives each algorithm that many
+// milliseconds and, unless --iterations is also given, no iteration limit; the geometric
+// and lundy-mees schedules then cool over the time budget instead of an iteration count.
+// --bench runs the fixed benchmark corpus (see runBenchmarks) plus any TSPLIB files and prints CSV.
+int main(int argc, char* argv[])
 {
-  double distanceMatrix[5][5] =
-                            {
-                              {0, 15, 20, 22, 30},
-                              {15, 0, 10, 12, 25},
-                              {20, 10, 0, 8, 22},
-                              {22, 12, 8, 0, 18},
-                              {30, 25, 22, 18, 0}
-                            };
+  string fileName;
+  vector<string> fileNames;
+  bool bench = false;
+  int threads = max(1u, thread::hardware_concurrency());
+  int starts = -1;
+  double restartGap = -1;
+  long long maxIterations = -1;
+  long long timeLimit = -1;
+  string scheduleName = "geometric";
+  int replicas = 0;
+  ConvergenceTrace::Mode traceMode = ConvergenceTrace::DECIMATED;
+  string traceFileName;
+  uint64_t seed = random_device{}();
+  for (int i = 1; i < argc; ++i)
+  {
+    string argument = argv[i];
+    if (argument == "--threads" && i + 1 < argc)
+    {
+      threads = max(1, stoi(argv[++i]));
+    }
+    else if (argument == "--starts" && i + 1 < argc)
+    {
+      starts = max(1, stoi(argv[++i]));
+    }
+    else if (argument == "--restart" && i + 1 < argc)
+    {
+      restartGap = stod(argv[++i]);
+    }
+    else if (argument == "--iterations" && i + 1 < argc)
+    {
+      maxIterations = max(1LL, stoll(argv[++i]));
+    }
+    else if (argument == "--tempering" && i + 1 < argc)
+    {
+      replicas = max(1, stoi(argv[++i]));
+    }
+    else if (argument == "--trace" && i + 1 < argc)
+    {
+      traceMode = string(argv[++i]) == "improvements" ? ConvergenceTrace::IMPROVEMENTS : ConvergenceTrace::DECIMATED;
+    }
+    else if (argument == "--schedule" && i + 1 < argc)
+    {
+      scheduleName = argv[++i];
+    }
+    else if (argument == "--time-limit" && i + 1 < argc)
+    {
+      timeLimit = max(1LL, stoll(argv[++i]));
+    }
+    else if (argument == "--seed" && i + 1 < argc)
+    {
+      seed = stoull(argv[++i]);
+    }
+    else if (argument == "--trace-file" && i + 1 < argc)
+    {
+      traceFileName = argv[++i];
+    }
+    else if (argument == "--bench")
+    {
+      bench = true;
+    }
+    else
+    {
+      fileNames.push_back(argument);
+    }
+  }
+  if (bench)
+  {
+    return runBenchmarks(fileNames);
+  }
+  if (!fileNames.empty())
+  {
+    fileName = fileNames.back();
+  }
+  if (starts < 0)
+  {
+    starts = threads;
+  }
+  // Only a deadline to go on, so iteration-based schedules run on the clock
+  bool timedSchedule = timeLimit > 0 && maxIterations < 0;
+  if (maxIterations < 0)
+  {
+    maxIterations = timeLimit < 0 ? 20 : numeric_limits<long long>::max();
+  }
+  if (scheduleName != "geometric" && scheduleName != "lundy-mees" && scheduleName != "adaptive")
+  {
+    cerr << "Unknown schedule " << scheduleName << endl;
+    return 1;
+  }
 
-  vector<CampusVisit> campuses =
+  DistanceMatrix distanceMatrix;
+  vector<CampusVisit> campuses;
+  if (!fileName.empty())
+  {
+    vector<string> names;
+    if (!loadTsplib(fileName, distanceMatrix, names))
+    {
+      return 1;
+    }
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+      campuses.push_back({static_cast<int>(i), names[i]});
+    }
+    cout << "Loaded " << fileName << ": " << distanceMatrix.size() << " cities, "
+         << distanceMatrix.memoryUsage() / (1024.0 * 1024.0) << " MB of distances" << endl;
+  }
+  else
+  {
+    distanceMatrix = DistanceMatrix::fromRows(
                               {
-                                {0, "Hatfield"},
-                                {1, "Hillcrest"},
-                                {2, "Groenkloof"},
-                                {3, "Prinsof"},
-                                {4, "Mamelodi"}
-                              };
-
-  int maxIterations = 20;
+                                {0, 15, 20, 22, 30},
+                                {15, 0, 10, 12, 25},
+                                {20, 10, 0, 8, 22},
+                                {22, 12, 8, 0, 18},
+                                {30, 25, 22, 18, 0}
+                              });
+
+    campuses =
+              {
+                {0, "Hatfield"},
+                {1, "Hillcrest"},
+                {2, "Groenkloof"},
+                {3, "Prinsof"},
+                {4, "Mamelodi"}
+              };
+  }
+
+  CandidateLists candidates(distanceMatrix, 10);
   double initialTemperature = 1000;
   double coolingRate = 0.99;
+  // Where the geometric schedule ends up, kept away from 0 for unbounded runs
+  double finalTemperature = max(initialTemperature * pow(coolingRate, min(maxIterations, 100000LL)), initialTemperature * 1e-6);
+  // Schedule for an SA run stopping at stop
+  auto makeSchedule = [&](const StopCondition& stop)
+  {
+    CoolingSchedule schedule = CoolingSchedule::geometric(initialTemperature, coolingRate);
+    if (scheduleName == "lundy-mees")
+    {
+      schedule = CoolingSchedule::lundyMees(initialTemperature, finalTemperature, maxIterations);
+    }
+    else if (scheduleName == "adaptive")
+    {
+      schedule = CoolingSchedule::adaptive(initialTemperature);
+    }
+    if (timedSchedule)
+    {
+      schedule.followDeadline(stop.deadline - chrono::milliseconds(timeLimit), stop.deadline, finalTemperature);
+    }
+    return schedule;
+  };
+  // Stop condition for an algorithm starting now
+  auto makeStop = [&](int checkEvery)
+  {
+    StopCondition stop(maxIterations);
+    stop.checkEvery = checkEvery;
+    if (timeLimit > 0)
+    {
+      stop.deadline = chrono::steady_clock::now() + chrono::milliseconds(timeLimit);
+    }
+    return stop;
+  };
+
+  unique_ptr<TraceWriter> traceWriter;
+  if (!traceFileName.empty())
+  {
+    traceWriter.reset(new TraceWriter(traceFileName));
+    if (!traceWriter->isOpen())
+    {
+      cerr << "Failed to open " << traceFileName << endl;
+      return 1;
+    }
+  }
+  // Trace ids in the file: ILS trajectories first, then SA, then parallel tempering
+  auto makeTrace = [&](uint32_t id) { return ConvergenceTrace(traceMode, 1024, traceWriter.get(), id); };
+
+  cout << "Seed: " << seed << endl;
+  cout << starts << " trajectories on " << min(threads, starts) << " threads" << endl << endl;
 
   cout << "Iterated Local Search:\n";
+  SharedIncumbent ilsIncumbent;
   auto start = chrono::high_resolution_clock::now();
-  pair<vector<CampusVisit>, vector<double>> ilsResult = iteratedLocalSearch(generateRandomRoute(campuses), distanceMatrix, maxIterations);
+  StopCondition ilsStop = makeStop(1);
+  vector<SearchResult> ilsResults = multiStart(starts, threads, ilsIncumbent, restartGap, [&](int trajectory, const Cooperation& cooperation)
+  {
+    Rng rng(seed, trajectory);
+    return iteratedLocalSearch(generateRandomRoute(campuses.size(), rng), distanceMatrix, candidates, ilsStop, rng, makeTrace(trajectory), cooperation);
+  });
+  const SearchResult& ilsResult = bestResult(ilsResults);
   auto end = chrono::high_resolution_clock::now();
   auto elapsed = chrono::duration_cast<chrono::microseconds>(end - start);
   cout << "Time taken by ILS: " << elapsed.count() << " microseconds" << endl;
   cout << "Distances:\n";
   printDistances(ilsResult.second);
   cout << "Best Route (ILS): ";
-  printRoute(ilsResult.first);
+  printRoute(ilsResult.first, campuses);
   cout << "Distance: " << calculateRouteDistance(ilsResult.first, distanceMatrix) << endl << endl;
 
   cout << "Simulated Annealing:\n";
+  SharedIncumbent saIncumbent;
   start = chrono::high_resolution_clock::now();
-  pair<vector<CampusVisit>, vector<double>> saResult = simulatedAnnealing(campuses, distanceMatrix, initialTemperature, coolingRate, maxIterations);
+  StopCondition saStop = makeStop(256);
+  vector<SearchResult> saResults = multiStart(starts, threads, saIncumbent, restartGap, [&](int trajectory, const Cooperation& cooperation)
+  {
+    Rng rng(seed, starts + trajectory);
+    return simulatedAnnealing(campuses.size(), distanceMatrix, makeSchedule(saStop), saStop, rng, makeTrace(starts + trajectory), cooperation);
+  });
+  const SearchResult& saResult = bestResult(saResults);
   end = chrono::high_resolution_clock::now();
   elapsed = chrono::duration_cast<chrono::microseconds>(end - start);
   cout << "Time taken by SA: " << elapsed.count() << " microseconds" << endl;
   cout << "Distances:\n";
   printDistances(saResult.second);
   cout << "Best Route (SA): ";
-  printRoute(saResult.first);
+  printRoute(saResult.first, campuses);
   cout << "Distance: " << calculateRouteDistance(saResult.first, distanceMatrix) << endl;
+
+  if (replicas > 0)
+  {
+    cout << endl << "Parallel Tempering (" << replicas << " replicas):\n";
+    start = chrono::high_resolution_clock::now();
+    pair<Tour, ConvergenceTrace> ptResult = parallelTempering(campuses.size(), distanceMatrix, replicas, initialTemperature, finalTemperature, makeStop(256), static_cast<int>(min(100LL, maxIterations)), seed + 1, makeTrace(2 * starts));
+    end = chrono::high_resolution_clock::now();
+    elapsed = chrono::duration_cast<chrono::microseconds>(end - start);
+    cout << "Time taken by PT: " << elapsed.count() << " microseconds" << endl;
+    cout << "Distances:\n";
+    printDistances(ptResult.second);
+    cout << "Best Route (PT): ";
+    printRoute(ptResult.first, campuses);
+    cout << "Distance: " << calculateRouteDistance(ptResult.first, distanceMatrix) << endl;
+  }
   return 0;
-}
\ No newline at end of file
+}
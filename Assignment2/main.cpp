@@ -2,9 +2,25 @@
 #include <fstream>
 #include <string>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <charconv>
+#include <cstring>
 #include <map>
 #include <vector>
 #include <chrono>
+#include <cstdint>
+#include <immintrin.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <filesystem>
+#include <glob.h>
+#include <sstream>
 //These are only used for Z testing
 #include <numeric>
 #include <cmath>
@@ -24,249 +40,1977 @@ double calculateStdDev(const vector<double>& data, double mean)
     }
     return sqrt(variance);
 }
-int numRuns = 30;
-vector<double> fitness_with_ls(numRuns);
-vector<double> fitness_without_ls(numRuns);
-int numItems, maxWeight;
-int populationSize = 100, selectionSize = 4, maxGenerations = 5;
-double crossoverRate = 0.85, mutationRate = 0.6;
-double baseMutationRate = 0.03;
-double maxMutationRate = 0.6;
-struct Item 
-{
-    double weight;
-    double value;
+int numThreads = max(1u, thread::hardware_concurrency());
+// Small, fast random number generator (xoshiro256**). The initial population and every
+// offspring pair of every generation get their own stream of the run's seed, so a run
+// gives the same result for a given seed however many threads it uses.
+class Rng
+{
+public:
+    explicit Rng(uint64_t seed, uint64_t stream = 0)
+    {
+        // splitmix64 spreads the seed over the whole state
+        uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (uint64_t &word : state)
+        {
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+    uint64_t next()
+    {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+    // Uniform integer in [0, bound) without modulo bias (Lemire's multiply and reject)
+    uint32_t below(uint32_t bound)
+    {
+        uint64_t product = (next() >> 32) * bound;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < bound)
+        {
+            uint32_t threshold = -bound % bound;
+            while (low < threshold)
+            {
+                product = (next() >> 32) * bound;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return product >> 32;
+    }
+    // Uniform double in [0, 1)
+    double uniform() 
+    { 
+        return (next() >> 11) * 0x1.0p-53; 
+    }
+private:
+    uint64_t state[4];
+    static uint64_t rotl(uint64_t x, int k) 
+    { 
+        return (x << k) | (x >> (64 - k)); 
+    }
+};
+// Runs tasks 0..count-1 on threads that are started once and reused for every call.
+// Each worker is dealt one contiguous range of tasks; when its own range runs out it
+// steals single tasks from the front of the other workers' ranges. The calling thread
+// works as worker 0.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int threads) : ranges(new Range[threads]), numWorkers(threads)
+    {
+        for (int i = 1; i < numWorkers; i++)
+        {
+            workers.emplace_back(&WorkerPool::wait, this, i);
+        }
+    }
+    ~WorkerPool()
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+    void run(int count, const function<void(int)> &task)
+    {
+        for (int i = 0; i < numWorkers; i++)
+        {
+            ranges[i].next = count * i / numWorkers;
+            ranges[i].end = count * (i + 1) / numWorkers;
+        }
+        if (numWorkers == 1)
+        {
+            work(0, task);
+            return;
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            currentTask = &task;
+            running = numWorkers - 1;
+            batch++;
+        }
+        wake.notify_all();
+        work(0, task);
+        unique_lock<mutex> guard(lock);
+        done.wait(guard, [this] { return running == 0; });
+    }
+private:
+    // Padded so workers claiming tasks from their own ranges don't share cache lines
+    struct alignas(64) Range
+    {
+        atomic<int> next{0};
+        int end = 0;
+    };
+    void work(int worker, const function<void(int)> &task)
+    {
+        for (int k = 0; k < numWorkers; k++)
+        {
+            Range &range = ranges[(worker + k) % numWorkers];
+            for (int i = range.next.fetch_add(1); i < range.end; i = range.next.fetch_add(1))
+            {
+                task(i);
+            }
+        }
+    }
+    void wait(int worker)
+    {
+        long long seen = 0;
+        while (true)
+        {
+            const function<void(int)> *task;
+            {
+                unique_lock<mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || batch != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = batch;
+                task = currentTask;
+            }
+            work(worker, *task);
+            lock_guard<mutex> guard(lock);
+            if (--running == 0)
+            {
+                done.notify_one();
+            }
+        }
+    }
+    unique_ptr<Range[]> ranges;
+    int numWorkers;
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake, done;
+    const function<void(int)> *currentTask = nullptr;
+    long long batch = 0;
+    int running = 0;
+    bool stopping = false;
 };
+// Genes are packed 64 to a word: gene i is bit i % 64 of genes[i / 64].
+// Bits past numItems are always 0. totalWeight and totalValue are kept up to date
+// with the genes so a single flip can be scored without summing everything again.
+// The genes belong to a Population's gene block (or some other buffer the caller owns),
+// so copying a Chromosome only copies the pointer - use copyChromosome to copy the genes.
 struct Chromosome 
 {
-    vector<bool> genes;
-    double fitness;
+    uint64_t *genes = nullptr;
+    double fitness = 0;
+    double totalWeight = 0;
+    double totalValue = 0;
+};
+bool getGene(const Chromosome &chromosome, int i)
+{
+    return (chromosome.genes[i / 64] >> (i % 64)) & 1;
+}
+void flipGene(Chromosome &chromosome, int i)
+{
+    chromosome.genes[i / 64] ^= 1ULL << (i % 64);
+}
+void copyChromosome(Chromosome &destination, const Chromosome &source, int words)
+{
+    copy(source.genes, source.genes + words, destination.genes);
+    destination.fitness = source.fitness;
+    destination.totalWeight = source.totalWeight;
+    destination.totalValue = source.totalValue;
+}
+// All genes of a population in one contiguous block, words words per chromosome.
+// Two of these are allocated per run and swapped every generation.
+struct Population
+{
+    vector<uint64_t> genes;
+    vector<Chromosome> chromosomes;
+};
+void allocatePopulation(Population &population, int size, int words)
+{
+    population.genes.assign(size * words, 0);
+    population.chromosomes.assign(size, Chromosome());
+    for (int i = 0; i < size; i++)
+    {
+        population.chromosomes[i].genes = population.genes.data() + i * words;
+    }
+}
+// Sums the weight and value of the selected items. Only visits set bits.
+void sumSelectedScalar(const uint64_t *genes, int words, const double *itemWeights, const double *itemValues, double &totalWeight, double &totalValue)
+{
+    for (int w = 0; w < words; w++)
+    {
+        for (uint64_t bits = genes[w]; bits != 0; bits &= bits - 1)
+        {
+            int i = w * 64 + __builtin_ctzll(bits);
+            totalWeight += itemWeights[i];
+            totalValue += itemValues[i];
+        }
+    }
+}
+// Same sums, 4 items at a time: each nibble of a word picks a lane mask from a table
+__attribute__((target("avx2"))) void sumSelectedAvx2(const uint64_t *genes, int words, const double *itemWeights, const double *itemValues, double &totalWeight, double &totalValue)
+{
+    alignas(32) static const int64_t laneMasks[16][4] = {
+        {0, 0, 0, 0}, {-1, 0, 0, 0}, {0, -1, 0, 0}, {-1, -1, 0, 0},
+        {0, 0, -1, 0}, {-1, 0, -1, 0}, {0, -1, -1, 0}, {-1, -1, -1, 0},
+        {0, 0, 0, -1}, {-1, 0, 0, -1}, {0, -1, 0, -1}, {-1, -1, 0, -1},
+        {0, 0, -1, -1}, {-1, 0, -1, -1}, {0, -1, -1, -1}, {-1, -1, -1, -1}};
+    __m256d weightSum = _mm256_setzero_pd();
+    __m256d valueSum = _mm256_setzero_pd();
+    for (int w = 0; w < words; w++)
+    {
+        uint64_t bits = genes[w];
+        if (bits == 0)
+        {
+            continue;
+        }
+        const double *weights = itemWeights + w * 64;
+        const double *values = itemValues + w * 64;
+        for (int q = 0; q < 16; q++, bits >>= 4)
+        {
+            __m256d mask = _mm256_load_pd(reinterpret_cast<const double *>(laneMasks[bits & 15]));
+            weightSum = _mm256_add_pd(weightSum, _mm256_and_pd(mask, _mm256_loadu_pd(weights + 4 * q)));
+            valueSum = _mm256_add_pd(valueSum, _mm256_and_pd(mask, _mm256_loadu_pd(values + 4 * q)));
+        }
+    }
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, weightSum);
+    totalWeight += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_store_pd(lanes, valueSum);
+    totalValue += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+// Same sums, 8 items at a time: each byte of a word is used directly as a lane mask
+__attribute__((target("avx512f"))) void sumSelectedAvx512(const uint64_t *genes, int words, const double *itemWeights, const double *itemValues, double &totalWeight, double &totalValue)
+{
+    __m512d weightSum = _mm512_setzero_pd();
+    __m512d valueSum = _mm512_setzero_pd();
+    for (int w = 0; w < words; w++)
+    {
+        uint64_t bits = genes[w];
+        if (bits == 0)
+        {
+            continue;
+        }
+        const double *weights = itemWeights + w * 64;
+        const double *values = itemValues + w * 64;
+        for (int b = 0; b < 8; b++, bits >>= 8)
+        {
+            __mmask8 mask = static_cast<__mmask8>(bits);
+            weightSum = _mm512_mask_add_pd(weightSum, mask, weightSum, _mm512_loadu_pd(weights + 8 * b));
+            valueSum = _mm512_mask_add_pd(valueSum, mask, valueSum, _mm512_loadu_pd(values + 8 * b));
+        }
+    }
+    totalWeight += _mm512_reduce_add_pd(weightSum);
+    totalValue += _mm512_reduce_add_pd(valueSum);
+}
+// Picks the widest kernel this CPU supports
+typedef void (*SumSelectedFunction)(const uint64_t *, int, const double *, const double *, double &, double &);
+SumSelectedFunction chooseSumSelected()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return sumSelectedAvx512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return sumSelectedAvx2;
+    }
+    return sumSelectedScalar;
+}
+SumSelectedFunction sumSelected = chooseSumSelected();
+// One knapsack problem. Item weights and values are separate columns, padded with zeros
+// to numWords * 64 items so the fitness kernels can always load whole words' worth.
+struct KnapsackInstance
+{
+    string name;
+    int numItems = 0;
+    int64_t maxWeight = 0;
+    int numWords = 0;
+    vector<double> itemWeights;
+    vector<double> itemValues;
+    // Item indices from the best value/weight ratio to the worst, for repair and branch and bound
+    vector<int> ratioOrder;
+    // Item indices from the lightest to the heaviest, for local search's swap move
+    vector<int> weightOrder;
+};
+void sortItems(KnapsackInstance &instance)
+{
+    instance.ratioOrder.resize(instance.numItems);
+    iota(instance.ratioOrder.begin(), instance.ratioOrder.end(), 0);
+    // Cross-multiplied so items with no weight come first rather than dividing by zero
+    stable_sort(instance.ratioOrder.begin(), instance.ratioOrder.end(), [&](int a, int b)
+    {
+        return instance.itemValues[a] * instance.itemWeights[b] > instance.itemValues[b] * instance.itemWeights[a];
+    });
+    instance.weightOrder.resize(instance.numItems);
+    iota(instance.weightOrder.begin(), instance.weightOrder.end(), 0);
+    stable_sort(instance.weightOrder.begin(), instance.weightOrder.end(), [&](int a, int b)
+    {
+        return instance.itemWeights[a] < instance.itemWeights[b];
+    });
+}
+// Binary instances start with this tag, then numItems and maxWeight as 64-bit integers,
+// then numItems values and numItems weights as doubles, all little endian.
+const char binaryTag[8] = {'K', 'N', 'A', 'P', 'S', 'A', 'C', 'K'};
+void resizeInstance(KnapsackInstance &instance, int numItems, int64_t maxWeight)
+{
+    instance.numItems = numItems;
+    instance.maxWeight = maxWeight;
+    instance.numWords = (numItems + 63) / 64;
+    instance.itemWeights.assign(instance.numWords * 64, 0);
+    instance.itemValues.assign(instance.numWords * 64, 0);
+}
+bool parseBinaryInstance(const char *data, size_t size, const string &fileName, KnapsackInstance &instance)
+{
+    int64_t header[2];
+    if (size < sizeof(binaryTag) + sizeof(header))
+    {
+        cerr << fileName << " is too short for a binary instance." << endl;
+        return false;
+    }
+    memcpy(header, data + sizeof(binaryTag), sizeof(header));
+    if (header[0] <= 0 || header[0] > INT32_MAX || size != sizeof(binaryTag) + sizeof(header) + 2 * header[0] * sizeof(double))
+    {
+        cerr << fileName << " has the wrong size for its item count." << endl;
+        return false;
+    }
+    if (header[1] < 0)
+    {
+        cerr << fileName << " has a negative capacity." << endl;
+        return false;
+    }
+    resizeInstance(instance, header[0], header[1]);
+    const char *columns = data + sizeof(binaryTag) + sizeof(header);
+    memcpy(instance.itemValues.data(), columns, instance.numItems * sizeof(double));
+    memcpy(instance.itemWeights.data(), columns + instance.numItems * sizeof(double), instance.numItems * sizeof(double));
+    return true;
+}
+// Reads whitespace separated numbers straight out of the mapped file. A number has to end
+// at whitespace or the end of the file, so "10.5" is not read as the integer 10.
+class NumberReader
+{
+public:
+    NumberReader(const char *begin, const char *end) : position(begin), end(end) {}
+    template <typename T> bool read(T &number)
+    {
+        while (position < end && isspace(static_cast<unsigned char>(*position)))
+        {
+            position++;
+        }
+        from_chars_result result = from_chars(position, end, number);
+        if (result.ec != errc() || (result.ptr < end && !isspace(static_cast<unsigned char>(*result.ptr))))
+        {
+            return false;
+        }
+        position = result.ptr;
+        return true;
+    }
+private:
+    const char *position;
+    const char *end;
+};
+bool parseTextInstance(const char *data, size_t size, const string &fileName, KnapsackInstance &instance)
+{
+    NumberReader reader(data, data + size);
+    int numItems;
+    int64_t maxWeight;
+    if (!reader.read(numItems) || !reader.read(maxWeight) || numItems <= 0 || maxWeight < 0)
+    {
+        cerr << fileName << " is not a knapsack instance." << endl;
+        return false;
+    }
+    resizeInstance(instance, numItems, maxWeight);
+    for (int i = 0; i < numItems; i++)
+    {
+        if (!reader.read(instance.itemValues[i]) || !reader.read(instance.itemWeights[i]))
+        {
+            cerr << fileName << " ends before item " << i + 1 << "." << endl;
+            return false;
+        }
+    }
+    return true;
+}
+// Loads a text instance ("numItems maxWeight" then one "value weight" line per item)
+// or a binary one, told apart by the tag. The file is memory-mapped rather than streamed.
+bool loadInstance(const string &fileName, KnapsackInstance &instance)
+{
+    int file = open(fileName.c_str(), O_RDONLY);
+    if (file < 0) 
+    {
+        cerr << "Failed to open the file." << endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        cerr << fileName << " is empty." << endl;
+        close(file);
+        return false;
+    }
+    size_t size = status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Failed to map the file");
+        return false;
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    const char *data = static_cast<const char *>(mapping);
+    instance.name = filesystem::path(fileName).filename().string();
+    bool loaded;
+    if (size >= sizeof(binaryTag) && memcmp(data, binaryTag, sizeof(binaryTag)) == 0)
+    {
+        loaded = parseBinaryInstance(data, size, fileName, instance);
+    }
+    else
+    {
+        loaded = parseTextInstance(data, size, fileName, instance);
+    }
+    munmap(mapping, size);
+    if (loaded)
+    {
+        sortItems(instance);
+    }
+    return loaded;
+}
+bool saveBinaryInstance(const string &fileName, const KnapsackInstance &instance)
+{
+    ofstream outputFile(fileName, ios::binary);
+    int64_t header[2] = {instance.numItems, instance.maxWeight};
+    outputFile.write(binaryTag, sizeof(binaryTag));
+    outputFile.write(reinterpret_cast<const char *>(header), sizeof(header));
+    outputFile.write(reinterpret_cast<const char *>(instance.itemValues.data()), instance.numItems * sizeof(double));
+    outputFile.write(reinterpret_cast<const char *>(instance.itemWeights.data()), instance.numItems * sizeof(double));
+    if (!outputFile)
+    {
+        cerr << "Failed to write " << fileName << "." << endl;
+        return false;
+    }
+    return true;
+}
+enum LocalSearchMode
+{
+    FIRST_IMPROVEMENT,
+    BEST_IMPROVEMENT
+};
+enum Topology
+{
+    RING,
+    COMPLETE
+};
+struct GAConfig
+{
+    int populationSize = 100;
+    int selectionSize = 4;
+    int maxGenerations = 5;
+    double crossoverRate = 0.85;
+    double mutationRate = 0.6;
+    bool localSearchEnabled = false;
+    LocalSearchMode localSearchMode = FIRST_IMPROVEMENT;
+    // Threads used for the offspring of one generation
+    int threads = 1;
+    // Island model: islands populations of populationSize, each on its own thread. Every
+    // migrationInterval generations each island sends copies of its best migrants
+    // chromosomes to its neighbours in the topology and takes in whatever has arrived.
+    int islands = 1;
+    int migrationInterval = 10;
+    int migrants = 2;
+    Topology topology = RING;
+    // Stopping early, each off when 0: after stagnationLimit generations without a better
+    // best, once the best reaches targetFitness, after timeLimit seconds, or after
+    // maxEvaluations chromosomes have been evaluated. maxGenerations always applies.
+    int stagnationLimit = 0;
+    double targetFitness = 0;
+    double timeLimit = 0;
+    long long maxEvaluations = 0;
+    // Keep a GenerationStats per generation in the result
+    bool recordStats = false;
+    // Memory for the GenomeCache, 0 turns it off
+    size_t cacheBytes = 64 << 20;
+};
+// The settings the experiments use for an instance: the mutation rate grows with the
+// number of items, and GA-LS gets a fifth of the generations plain GA gets
+GAConfig defaultConfig(const KnapsackInstance &instance, bool localSearchEnabled)
+{
+    double baseMutationRate = 0.03;
+    double maxMutationRate = 0.6;
+    GAConfig config;
+    config.localSearchEnabled = localSearchEnabled;
+    config.maxGenerations = localSearchEnabled ? instance.numItems : 5 * instance.numItems;
+    config.mutationRate = min(baseMutationRate * instance.numItems, maxMutationRate);
+    return config;
+}
+// Generation 0 is the initial population
+struct GenerationStats
+{
+    int generation;
+    double seconds;
+    long long evaluations;
+    double bestFitness;
+    double meanFitness;
+    // Mean Hamming distance between two chromosomes, as a fraction of the genes
+    double diversity;
+};
+struct GAResult
+{
+    vector<bool> selected;
+    double fitness = 0;
+    double runtime = 0;
+    uint64_t seed = 0;
+    int generations = 0;
+    // Chromosomes evaluated: the initial population and every child. Flips scored
+    // incrementally by local search and repair are not counted.
+    long long evaluations = 0;
+    // Children whose repair and local search came from the GenomeCache
+    long long cacheHits = 0;
+    // Which limit ended the run: generations, stagnation, target, time or evaluations
+    string stopReason;
+    // (seconds since the start, best fitness) each time the best improved, starting with the initial population
+    vector<pair<double, double>> improvements;
+    vector<GenerationStats> stats;
+};
+// Lock-free single-producer single-consumer ring carrying migrants from one island to another
+class MigrantQueue
+{
+public:
+    MigrantQueue(int capacity, int words) : slots(capacity), genes(capacity * words), words(words)
+    {
+        for (int i = 0; i < capacity; i++)
+        {
+            slots[i].genes = genes.data() + i * words;
+        }
+    }
+    // Neither side ever waits: a full ring drops the migrant, an empty one gives nothing
+    bool push(const Chromosome &chromosome)
+    {
+        size_t back = tail.load(memory_order_relaxed);
+        if (back - head.load(memory_order_acquire) == slots.size())
+        {
+            return false;
+        }
+        copyChromosome(slots[back % slots.size()], chromosome, words);
+        tail.store(back + 1, memory_order_release);
+        return true;
+    }
+    bool pop(Chromosome &chromosome)
+    {
+        size_t front = head.load(memory_order_relaxed);
+        if (front == tail.load(memory_order_acquire))
+        {
+            return false;
+        }
+        copyChromosome(chromosome, slots[front % slots.size()], words);
+        head.store(front + 1, memory_order_release);
+        return true;
+    }
+private:
+    vector<Chromosome> slots;
+    vector<uint64_t> genes;
+    int words;
+    // On separate cache lines so the sender and receiver don't fight over them
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+};
+// The queues one island sends its migrants on and receives them from
+struct Migration
+{
+    vector<MigrantQueue *> outgoing;
+    vector<MigrantQueue *> incoming;
+};
+uint64_t hashGenes(const uint64_t *genes, int words)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    for (int w = 0; w < words; w++)
+    {
+        hash = (hash ^ genes[w]) * 0xBF58476D1CE4E5B9ull;
+        hash ^= hash >> 31;
+    }
+    return hash;
+}
+// Remembers what repair and local search made of a child, keyed by the child's genes
+// as they came out of crossover and mutation, so a repeat child costs one lookup.
+// Direct-mapped entries (the newest store wins a slot), as many as fit in the memory
+// it is given up to maxEntries; repeats come from the last few generations, so a few
+// generations' worth of entries is plenty. Each entry belongs to one of a set of locks, so threads only
+// contend when they land on the same stripe.
+class GenomeCache
+{
+public:
+    GenomeCache(size_t bytes, size_t maxEntries, int words) : words(words)
+    {
+        size_t entryBytes = sizeof(Entry) + 2 * words * sizeof(uint64_t);
+        size_t numEntries = 1;
+        while (numEntries * 2 * entryBytes <= bytes && numEntries * 2 <= maxEntries)
+        {
+            numEntries *= 2;
+        }
+        entries.resize(numEntries);
+        genes.resize(numEntries * 2 * words);
+    }
+    // Copies the remembered result into chromosome if its genes have been seen before
+    bool find(uint64_t hash, Chromosome &chromosome)
+    {
+        size_t index = hash & (entries.size() - 1);
+        lock_guard<mutex> guard(stripes[index % numStripes].lock);
+        const Entry &entry = entries[index];
+        const uint64_t *key = genes.data() + index * 2 * words;
+        if (!entry.used || entry.hash != hash || !equal(key, key + words, chromosome.genes))
+        {
+            return false;
+        }
+        copy(key + words, key + 2 * words, chromosome.genes);
+        chromosome.fitness = entry.fitness;
+        chromosome.totalWeight = entry.totalWeight;
+        chromosome.totalValue = entry.totalValue;
+        return true;
+    }
+    void store(uint64_t hash, const uint64_t *key, const Chromosome &result)
+    {
+        size_t index = hash & (entries.size() - 1);
+        lock_guard<mutex> guard(stripes[index % numStripes].lock);
+        Entry &entry = entries[index];
+        uint64_t *slot = genes.data() + index * 2 * words;
+        copy(key, key + words, slot);
+        copy(result.genes, result.genes + words, slot + words);
+        entry = {hash, true, result.fitness, result.totalWeight, result.totalValue};
+    }
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        bool used;
+        double fitness;
+        double totalWeight;
+        double totalValue;
+    };
+    struct alignas(64) Stripe
+    {
+        mutex lock;
+    };
+    static const int numStripes = 64;
+    vector<Entry> entries;
+    // The key's words then the result's words for each entry
+    vector<uint64_t> genes;
+    int words;
+    Stripe stripes[numStripes];
+};
+// One GA run on one instance. Everything a run touches lives in the object, so
+// separate GeneticAlgorithm objects can run on separate threads at the same time.
+class GeneticAlgorithm
+{
+public:
+    GeneticAlgorithm(const KnapsackInstance &instance, const GAConfig &config) : instance(instance), config(config) {}
+    // With a Migration the run is one island of an island model
+    GAResult run(uint64_t seed, Migration *migration = nullptr);
+private:
+    double fitnessOf(double totalWeight, double totalValue) const
+    {
+        return totalWeight > instance.maxWeight ? 0 : totalValue;
+    }
+    void setFitness(Chromosome &chromosome) const;
+    double flipFitness(const Chromosome &chromosome, int i) const;
+    void applyFlip(Chromosome &chromosome, int i) const;
+    void repair(Chromosome &chromosome) const;
+    void improve(Chromosome &chromosome, GenomeCache *cache, atomic<long long> &cacheHits) const;
+    void setPopulationFitness();
+    void generatePopulation(Rng &rng);
+    int getParent(Rng &rng) const;
+    void crossover(Chromosome &child1, Chromosome &child2, Rng &rng) const;
+    void mutate(Chromosome &chromosome, Rng &rng) const;
+    int getBestChromosome() const;
+    void migrate(Migration &migration, vector<int> &ranking);
+    double diversity(vector<int> &geneCounts) const;
+    bool findSwap(const Chromosome &chromosome, bool firstImprovement, int &drop, int &add) const;
+    void localSearch(Chromosome &chromosome) const;
+    const KnapsackInstance &instance;
+    GAConfig config;
+    Population population, nextPopulation;
+    double populationFitness = 0;
+};
+// Recomputes the totals from scratch, then the fitness
+void GeneticAlgorithm::setFitness(Chromosome &chromosome) const
+{
+    chromosome.totalWeight = 0;
+    chromosome.totalValue = 0;
+    sumSelected(chromosome.genes, instance.numWords, instance.itemWeights.data(), instance.itemValues.data(), chromosome.totalWeight, chromosome.totalValue);
+    chromosome.fitness = fitnessOf(chromosome.totalWeight, chromosome.totalValue);
+}
+// Fitness the chromosome would have with gene i flipped, in O(1)
+double GeneticAlgorithm::flipFitness(const Chromosome &chromosome, int i) const
+{
+    double sign = getGene(chromosome, i) ? -1 : 1;
+    return fitnessOf(chromosome.totalWeight + sign * instance.itemWeights[i], chromosome.totalValue + sign * instance.itemValues[i]);
+}
+// Flips gene i and updates the totals and fitness in O(1)
+void GeneticAlgorithm::applyFlip(Chromosome &chromosome, int i) const
+{
+    double sign = getGene(chromosome, i) ? -1 : 1;
+    flipGene(chromosome, i);
+    chromosome.totalWeight += sign * instance.itemWeights[i];
+    chromosome.totalValue += sign * instance.itemValues[i];
+    chromosome.fitness = fitnessOf(chromosome.totalWeight, chromosome.totalValue);
+}
+// Makes an overweight chromosome feasible by dropping its worst-ratio items, then fills the
+// remaining capacity with the best-ratio items that still fit. Every chromosome the GA
+// evaluates is therefore a usable packing rather than a zero.
+void GeneticAlgorithm::repair(Chromosome &chromosome) const
+{
+    const vector<int> &order = instance.ratioOrder;
+    for (int k = instance.numItems - 1; k >= 0 && chromosome.totalWeight > instance.maxWeight; k--)
+    {
+        if (getGene(chromosome, order[k]))
+        {
+            applyFlip(chromosome, order[k]);
+        }
+    }
+    for (int k = 0; k < instance.numItems; k++)
+    {
+        int item = order[k];
+        if (!getGene(chromosome, item) && chromosome.totalWeight + instance.itemWeights[item] <= instance.maxWeight)
+        {
+            applyFlip(chromosome, item);
+        }
+    }
+}
+void GeneticAlgorithm::setPopulationFitness() 
+{
+    populationFitness = 0;
+    for (const Chromosome &chromosome : population.chromosomes)
+    {
+        populationFitness += chromosome.fitness;
+    }
+}
+void GeneticAlgorithm::generatePopulation(Rng &rng) 
+{
+    int numWords = instance.numWords;
+    for (Chromosome &chromosome : population.chromosomes) 
+    {
+        // Each gene is a fair coin, so whole random words will do; the bits past numItems are cleared
+        for (int w = 0; w < numWords; w++)
+        {
+            chromosome.genes[w] = rng.next();
+        }
+        if (instance.numItems % 64 != 0)
+        {
+            chromosome.genes[numWords - 1] &= (1ULL << (instance.numItems % 64)) - 1;
+        }
+        setFitness(chromosome);
+        repair(chromosome);
+    }
+}
+// Tournament selection, returns the index of the winner in the current population
+int GeneticAlgorithm::getParent(Rng &rng) const
+{
+    int parent = rng.below(population.chromosomes.size());
+    for (int i = 1; i < config.selectionSize; i++) 
+    {
+        int randomIndex = rng.below(population.chromosomes.size());
+        if (population.chromosomes[randomIndex].fitness > population.chromosomes[parent].fitness) 
+        {
+            parent = randomIndex;
+        }
+    }
+    return parent;
+}
+// Picks two parents from the current population and writes their children straight into child1 and child2
+void GeneticAlgorithm::crossover(Chromosome &child1, Chromosome &child2, Rng &rng) const
+{
+    const Chromosome &parent1 = population.chromosomes[getParent(rng)];
+    const Chromosome &parent2 = population.chromosomes[getParent(rng)];
+    if(rng.uniform() >= config.crossoverRate)
+    {
+        copyChromosome(child1, parent1, instance.numWords);
+        copyChromosome(child2, parent2, instance.numWords);
+        return;
+    }
+    int crossoverPoint = rng.below(instance.numItems);
+    // Whole words before and after the word holding the crossover point are copied as they are,
+    // that word is split with a mask
+    int splitWord = crossoverPoint / 64;
+    uint64_t lowMask = (1ULL << (crossoverPoint % 64)) - 1;
+    for (int w = 0; w < instance.numWords; w++)
+    {
+        uint64_t mask = w < splitWord ? ~0ULL : (w > splitWord ? 0 : lowMask);
+        child1.genes[w] = (parent1.genes[w] & mask) | (parent2.genes[w] & ~mask);
+        child2.genes[w] = (parent2.genes[w] & mask) | (parent1.genes[w] & ~mask);
+    }
+    setFitness(child1);
+    setFitness(child2);
+}
+void GeneticAlgorithm::mutate(Chromosome &chromosome, Rng &rng) const
+{
+    int mutationPoint = rng.below(instance.numItems);
+    applyFlip(chromosome, mutationPoint);
+}
+int GeneticAlgorithm::getBestChromosome() const
+{
+    int best = 0;
+    for (unsigned int i = 1; i < population.chromosomes.size(); i++)
+    {
+        if (population.chromosomes[i].fitness > population.chromosomes[best].fitness) 
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+// Looks for a 1-1 swap that raises the value: drop a selected item and add an unselected one
+// that fits in the room it leaves. The unselected items are walked in weight order keeping
+// the most valuable so far, so each selected item's best partner is a binary search away
+// and the whole scan is O(n log n). firstImprovement takes the first selected item (in item
+// order) with a gain, otherwise the largest gain wins. Returns false if no swap gains.
+bool GeneticAlgorithm::findSwap(const Chromosome &chromosome, bool firstImprovement, int &drop, int &add) const
+{
+    const vector<int> &order = instance.weightOrder;
+    int n = instance.numItems;
+    // mostValuable[p] is the most valuable unselected item among order[0, p), -1 if none
+    thread_local vector<int> mostValuable;
+    mostValuable.assign(n + 1, -1);
+    for (int p = 0; p < n; p++)
+    {
+        int item = order[p];
+        int best = mostValuable[p];
+        if (!getGene(chromosome, item) && (best < 0 || instance.itemValues[item] > instance.itemValues[best]))
+        {
+            best = item;
+        }
+        mostValuable[p + 1] = best;
+    }
+    double room = instance.maxWeight - chromosome.totalWeight;
+    double bestGain = 0;
+    drop = add = -1;
+    for (int i = 0; i < n; i++)
+    {
+        if (!getGene(chromosome, i))
+        {
+            continue;
+        }
+        double limit = room + instance.itemWeights[i];
+        int fitting = upper_bound(order.begin(), order.end(), limit, [&](double weight, int item)
+        {
+            return weight < instance.itemWeights[item];
+        }) - order.begin();
+        int j = mostValuable[fitting];
+        if (j >= 0 && instance.itemValues[j] - instance.itemValues[i] > bestGain)
+        {
+            bestGain = instance.itemValues[j] - instance.itemValues[i];
+            drop = i;
+            add = j;
+            if (firstImprovement)
+            {
+                return true;
+            }
+        }
+    }
+    return drop >= 0;
+}
+// Hill climbing over two moves: flipping one gene, scored in O(1) from the running totals,
+// and the 1-1 swaps of findSwap. Repair has already filled the knapsack greedily, so no
+// single flip helps a freshly repaired chromosome and the swaps do most of the work.
+// FIRST_IMPROVEMENT sweeps the genes in order taking any flip that helps, and only looks
+// for a swap once a sweep finds none; BEST_IMPROVEMENT takes the best flip or swap each step.
+void GeneticAlgorithm::localSearch(Chromosome &chromosome) const
+{
+    int drop, add;
+    if (config.localSearchMode == FIRST_IMPROVEMENT)
+    {
+        while (true)
+        {
+            bool improved = false;
+            for (int i = 0; i < instance.numItems; i++)
+            {
+                if (flipFitness(chromosome, i) > chromosome.fitness)
+                {
+                    applyFlip(chromosome, i);
+                    improved = true;
+                }
+            }
+            if (!improved)
+            {
+                if (!findSwap(chromosome, true, drop, add))
+                {
+                    return;
+                }
+                applyFlip(chromosome, drop);
+                applyFlip(chromosome, add);
+            }
+        }
+    }
+    while (true)
+    {
+        int bestGene = -1;
+        double bestFitness = chromosome.fitness;
+        for (int i = 0; i < instance.numItems; i++)
+        {
+            double fitness = flipFitness(chromosome, i);
+            if (fitness > bestFitness)
+            {
+                bestGene = i;
+                bestFitness = fitness;
+            }
+        }
+        // A swap always leaves the chromosome feasible, so its fitness is the new total value
+        if (findSwap(chromosome, false, drop, add) && chromosome.totalValue - instance.itemValues[drop] + instance.itemValues[add] > bestFitness)
+        {
+            applyFlip(chromosome, drop);
+            applyFlip(chromosome, add);
+            continue;
+        }
+        if (bestGene < 0)
+        {
+            return;
+        }
+        applyFlip(chromosome, bestGene);
+    }
+}
+// Sends copies of the best chromosomes out, then overwrites the worst with any arrivals
+void GeneticAlgorithm::migrate(Migration &migration, vector<int> &ranking)
+{
+    int migrants = min(config.migrants, (int)ranking.size());
+    // Sorted in full, not just the emigrants, so arrivals really do replace the worst
+    // chromosomes; a population-sized sort is nothing next to a generation of evaluations
+    sort(ranking.begin(), ranking.end(), [&](int a, int b)
+    {
+        return population.chromosomes[a].fitness > population.chromosomes[b].fitness;
+    });
+    for (MigrantQueue *queue : migration.outgoing)
+    {
+        for (int k = 0; k < migrants; k++)
+        {
+            queue->push(population.chromosomes[ranking[k]]);
+        }
+    }
+    // Arrivals go in from the worst up, stopping short of the emigrants
+    int next = ranking.size() - 1;
+    for (MigrantQueue *queue : migration.incoming)
+    {
+        while (next >= migrants && queue->pop(population.chromosomes[ranking[next]]))
+        {
+            next--;
+        }
+    }
+}
+// Counts how many chromosomes carry each gene; a gene held by c of P chromosomes differs
+// in c * (P - c) of the pairs. Only visits set bits.
+double GeneticAlgorithm::diversity(vector<int> &geneCounts) const
+{
+    fill(geneCounts.begin(), geneCounts.end(), 0);
+    for (const Chromosome &chromosome : population.chromosomes)
+    {
+        for (int w = 0; w < instance.numWords; w++)
+        {
+            for (uint64_t bits = chromosome.genes[w]; bits != 0; bits &= bits - 1)
+            {
+                geneCounts[w * 64 + __builtin_ctzll(bits)]++;
+            }
+        }
+    }
+    double size = population.chromosomes.size();
+    if (size < 2)
+    {
+        return 0;
+    }
+    double differingPairs = 0;
+    for (int i = 0; i < instance.numItems; i++)
+    {
+        differingPairs += (double)geneCounts[i] * (size - geneCounts[i]);
+    }
+    return differingPairs / (size * (size - 1) / 2) / instance.numItems;
+}
+// Repair, then local search if it is on. The totals are summed again at the end so they
+// depend only on the final genes, whichever way the cache or the flips got there.
+void GeneticAlgorithm::improve(Chromosome &chromosome, GenomeCache *cache, atomic<long long> &cacheHits) const
+{
+    uint64_t hash = 0;
+    // The genes as they arrived, kept aside while repair and local search change them
+    thread_local vector<uint64_t> key;
+    if (cache != nullptr)
+    {
+        hash = hashGenes(chromosome.genes, instance.numWords);
+        if (cache->find(hash, chromosome))
+        {
+            cacheHits.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        key.assign(chromosome.genes, chromosome.genes + instance.numWords);
+    }
+    repair(chromosome);
+    if (config.localSearchEnabled)
+    {
+        localSearch(chromosome);
+    }
+    setFitness(chromosome);
+    if (cache != nullptr)
+    {
+        cache->store(hash, key.data(), chromosome);
+    }
+}
+GAResult GeneticAlgorithm::run(uint64_t seed, Migration *migration)
+{
+    int numWords = instance.numWords;
+    auto start = chrono::high_resolution_clock::now();
+    // Everything a generation needs is allocated here, the loop below only writes into it
+    allocatePopulation(population, config.populationSize, numWords);
+    allocatePopulation(nextPopulation, config.populationSize, numWords);
+    vector<uint64_t> bestGenes(numWords);
+    vector<int> ranking(config.populationSize);
+    vector<int> geneCounts(config.recordStats ? numWords * 64 : 0);
+    WorkerPool pool(config.threads);
+    unique_ptr<GenomeCache> cache;
+    if (config.cacheBytes > 0)
+    {
+        cache.reset(new GenomeCache(config.cacheBytes, 16 * config.populationSize, numWords));
+    }
+    atomic<long long> cacheHits(0);
+    int numPairs = config.populationSize / 2;
+    long long generation = 0;
+    // One offspring pair: select, crossover, mutate, repair and local search. Only reads the
+    // current population and only writes its own two children, so pairs can run in any order.
+    function<void(int)> makePair = [&](int j)
+    {
+        Rng pairRng(seed, 1 + generation * numPairs + j);
+        Chromosome &child1 = nextPopulation.chromosomes[2 * j];
+        Chromosome &child2 = nextPopulation.chromosomes[2 * j + 1];
+        crossover(child1, child2, pairRng);
+        if (pairRng.uniform() < config.mutationRate)
+        {
+            mutate(child1, pairRng);
+        }
+        if (pairRng.uniform() < config.mutationRate)
+        {
+            mutate(child2, pairRng);
+        }
+        improve(child1, cache.get(), cacheHits);
+        improve(child2, cache.get(), cacheHits);
+    };
+    Chromosome bestChromosome;
+    bestChromosome.genes = bestGenes.data();
+    // Stream 0 is the run's own, used for the initial population
+    Rng rng(seed);
+    generatePopulation(rng);
+    copyChromosome(bestChromosome, population.chromosomes[getBestChromosome()], numWords);
+    GAResult result;
+    result.improvements.emplace_back(chrono::duration<double>(chrono::high_resolution_clock::now() - start).count(), bestChromosome.fitness);
+    setPopulationFitness();
+    long long evaluations = config.populationSize;
+    int lastImprovement = 0;
+    if (config.recordStats)
+    {
+        result.stats.reserve(config.maxGenerations + 1);
+        result.stats.push_back({0, result.improvements[0].first, evaluations, bestChromosome.fitness, populationFitness / config.populationSize, diversity(geneCounts)});
+    }
+    result.stopReason = "generations";
+    int i = 0;
+    // The initial population may already be good enough
+    if (config.targetFitness > 0 && bestChromosome.fitness >= config.targetFitness)
+    {
+        result.stopReason = "target";
+    }
+    while (i < config.maxGenerations && result.stopReason == "generations") 
+    {
+        generation = i;
+        pool.run(numPairs, makePair);
+        swap(population, nextPopulation);
+        if (migration != nullptr && (i + 1) % config.migrationInterval == 0)
+        {
+            iota(ranking.begin(), ranking.end(), 0);
+            migrate(*migration, ranking);
+        }
+        setPopulationFitness();
+        i++;
+        evaluations += 2 * numPairs;
+        double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+        const Chromosome &newBestChromosome = population.chromosomes[getBestChromosome()];
+        if (newBestChromosome.fitness > bestChromosome.fitness)
+        {
+            copyChromosome(bestChromosome, newBestChromosome, numWords);
+            result.improvements.emplace_back(seconds, bestChromosome.fitness);
+            lastImprovement = i;
+        }
+        if (config.recordStats)
+        {
+            result.stats.push_back({i, seconds, evaluations, bestChromosome.fitness, populationFitness / config.populationSize, diversity(geneCounts)});
+        }
+        if (config.targetFitness > 0 && bestChromosome.fitness >= config.targetFitness)
+        {
+            result.stopReason = "target";
+            break;
+        }
+        if (config.stagnationLimit > 0 && i - lastImprovement >= config.stagnationLimit)
+        {
+            result.stopReason = "stagnation";
+            break;
+        }
+        if (config.timeLimit > 0 && seconds >= config.timeLimit)
+        {
+            result.stopReason = "time";
+            break;
+        }
+        if (config.maxEvaluations > 0 && evaluations >= config.maxEvaluations)
+        {
+            result.stopReason = "evaluations";
+            break;
+        }
+    }
+    auto end = chrono::high_resolution_clock::now();
+    result.generations = i;
+    result.evaluations = evaluations;
+    result.cacheHits = cacheHits;
+    result.selected.resize(instance.numItems);
+    for (int i = 0; i < instance.numItems; i++)
+    {
+        result.selected[i] = getGene(bestChromosome, i);
+    }
+    result.fitness = bestChromosome.fitness;
+    result.runtime = chrono::duration<double>(end - start).count();
+    result.seed = seed;
+    return result;
+}
+// Runs config.islands copies of the GA at once, each on its own thread with its own
+// stream of seeds, joined by migrant queues in the configured topology. The islands
+// never wait for each other, so unlike a single run the result depends on timing.
+GAResult runIslands(const KnapsackInstance &instance, const GAConfig &config, uint64_t seed)
+{
+    int islands = config.islands;
+    GAConfig islandConfig = config;
+    islandConfig.threads = 1;
+    vector<unique_ptr<MigrantQueue>> queues;
+    vector<Migration> migrations(islands);
+    for (int from = 0; from < islands; from++)
+    {
+        for (int to = 0; to < islands; to++)
+        {
+            bool linked = config.topology == RING ? to == (from + 1) % islands : to != from;
+            if (from != to && linked)
+            {
+                queues.emplace_back(new MigrantQueue(4 * config.migrants, instance.numWords));
+                migrations[from].outgoing.push_back(queues.back().get());
+                migrations[to].incoming.push_back(queues.back().get());
+            }
+        }
+    }
+    auto start = chrono::high_resolution_clock::now();
+    vector<GAResult> results(islands);
+    vector<thread> threads;
+    for (int k = 0; k < islands; k++)
+    {
+        threads.emplace_back([&, k]()
+        {
+            GeneticAlgorithm ga(instance, islandConfig);
+            results[k] = ga.run(seed + k * 0x9E3779B97F4A7C15ull, &migrations[k]);
+        });
+    }
+    for (thread &t : threads)
+    {
+        t.join();
+    }
+    GAResult best = results[0];
+    for (const GAResult &result : results)
+    {
+        if (result.fitness > best.fitness)
+        {
+            best = result;
+        }
+    }
+    // The islands started together, so their improvements merge into one history of the best so far
+    vector<pair<double, double>> improvements;
+    for (const GAResult &result : results)
+    {
+        improvements.insert(improvements.end(), result.improvements.begin(), result.improvements.end());
+    }
+    sort(improvements.begin(), improvements.end());
+    best.improvements.clear();
+    for (const pair<double, double> &improvement : improvements)
+    {
+        if (best.improvements.empty() || improvement.second > best.improvements.back().second)
+        {
+            best.improvements.push_back(improvement);
+        }
+    }
+    best.runtime = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    best.seed = seed;
+    best.evaluations = 0;
+    best.cacheHits = 0;
+    for (const GAResult &result : results)
+    {
+        best.evaluations += result.evaluations;
+        best.cacheHits += result.cacheHits;
+    }
+    return best;
+}
+GAResult runGA(const KnapsackInstance &instance, const GAConfig &config, uint64_t seed)
+{
+    if (config.islands > 1)
+    {
+        return runIslands(instance, config, seed);
+    }
+    GeneticAlgorithm ga(instance, config);
+    return ga.run(seed);
+}
+// Exact optimum of an instance, to measure the GA against
+struct ExactResult
+{
+    double optimum = 0;
+    vector<bool> selected;
+    string method;
+    double runtime = 0;
+    // False when branch and bound ran out of nodes or the solve was skipped. optimum is then
+    // only the best value found, and gaps and times to the optimum are reported as -1.
+    bool proven = true;
 };
-vector<Item> allItems;
-vector<Chromosome> population;
-double populationFitness = 0;
-void setFitness(Chromosome &chromosome) 
+// Largest DP table (items x capacity cells) solveExact will build, 1 bit of it per cell
+const long long maxDpCells = 1LL << 28;
+// Largest capacity the DP takes on whatever the number of items: its row of best values
+// is capacity + 1 doubles, 128 MB at this size
+const long long maxDpCapacity = 1LL << 24;
+// Relative slack when asking whether a GA fitness reached the optimum: the GA sums its
+// values in SIMD lane order and the exact solvers sum them in item order, so the same
+// selection can come out an ulp or so apart
+const double optimumTolerance = 1e-9;
+// Nodes branch and bound may visit before giving up on proving the optimum
+const long long defaultBranchNodes = 20000000;
+// One item's step of the DP: bestValue[c] = max(bestValue[c], bestValue[c - weight] + value)
+// for capacities from high down to low, setting bit c of row where taking the item wins.
+// Going down keeps bestValue[c - weight] the value without the item.
+void dpCapacities(double *bestValue, int high, int low, int weight, double value, uint64_t *row)
 {
-    double totalWeight = 0;
-    double totalValue = 0;
-    for (unsigned int i = 0; i < chromosome.genes.size(); i++)
+    for (int c = high; c >= low; c--)
+    {
+        if (bestValue[c - weight] + value > bestValue[c])
+        {
+            bestValue[c] = bestValue[c - weight] + value;
+            row[c / 64] |= 1ULL << (c % 64);
+        }
+    }
+}
+void dpItemScalar(double *bestValue, int capacity, int weight, double value, uint64_t *row)
+{
+    dpCapacities(bestValue, capacity, weight, weight, value, row);
+}
+// Same step 8 capacities at a time, whenever the item weighs at least 8 so a block never
+// reads a capacity it is writing. The compare mask of a block is its byte of the take row.
+// The capacities above the top whole block and below the last one go through the scalar step.
+__attribute__((target("avx2"))) void dpItemAvx2(double *bestValue, int capacity, int weight, double value, uint64_t *row)
+{
+    int top = (capacity + 1) / 8 * 8;
+    if (weight < 8 || top - 8 < weight)
     {
-        totalWeight += allItems[i].weight * chromosome.genes[i];
-        totalValue += allItems[i].value * chromosome.genes[i];
+        dpItemScalar(bestValue, capacity, weight, value, row);
+        return;
     }
-    if (totalWeight > maxWeight)
+    dpCapacities(bestValue, capacity, top, weight, value, row);
+    uint8_t *bits = reinterpret_cast<uint8_t *>(row);
+    __m256d add = _mm256_set1_pd(value);
+    int c = top - 8;
+    for (; c >= weight; c -= 8)
     {
-        chromosome.fitness = 0;
-    } 
-    else 
+        __m256d takenLow = _mm256_add_pd(_mm256_loadu_pd(bestValue + c - weight), add);
+        __m256d takenHigh = _mm256_add_pd(_mm256_loadu_pd(bestValue + c - weight + 4), add);
+        __m256d keptLow = _mm256_loadu_pd(bestValue + c);
+        __m256d keptHigh = _mm256_loadu_pd(bestValue + c + 4);
+        __m256d betterLow = _mm256_cmp_pd(takenLow, keptLow, _CMP_GT_OQ);
+        __m256d betterHigh = _mm256_cmp_pd(takenHigh, keptHigh, _CMP_GT_OQ);
+        _mm256_storeu_pd(bestValue + c, _mm256_blendv_pd(keptLow, takenLow, betterLow));
+        _mm256_storeu_pd(bestValue + c + 4, _mm256_blendv_pd(keptHigh, takenHigh, betterHigh));
+        bits[c / 8] = static_cast<uint8_t>(_mm256_movemask_pd(betterLow) | _mm256_movemask_pd(betterHigh) << 4);
+    }
+    dpCapacities(bestValue, c + 7, weight, weight, value, row);
+}
+__attribute__((target("avx512f"))) void dpItemAvx512(double *bestValue, int capacity, int weight, double value, uint64_t *row)
+{
+    int top = (capacity + 1) / 8 * 8;
+    if (weight < 8 || top - 8 < weight)
+    {
+        dpItemScalar(bestValue, capacity, weight, value, row);
+        return;
+    }
+    dpCapacities(bestValue, capacity, top, weight, value, row);
+    uint8_t *bits = reinterpret_cast<uint8_t *>(row);
+    __m512d add = _mm512_set1_pd(value);
+    int c = top - 8;
+    for (; c >= weight; c -= 8)
     {
-        chromosome.fitness = totalValue;
+        __m512d taken = _mm512_add_pd(_mm512_loadu_pd(bestValue + c - weight), add);
+        __m512d kept = _mm512_loadu_pd(bestValue + c);
+        __mmask8 better = _mm512_cmp_pd_mask(taken, kept, _CMP_GT_OQ);
+        _mm512_storeu_pd(bestValue + c, _mm512_mask_blend_pd(better, kept, taken));
+        bits[c / 8] = better;
     }
+    dpCapacities(bestValue, c + 7, weight, weight, value, row);
 }
-void setPopulationFitness() 
+typedef void (*DpItemFunction)(double *, int, int, double, uint64_t *);
+DpItemFunction dpItem = sumSelected == sumSelectedAvx512 ? dpItemAvx512 : (sumSelected == sumSelectedAvx2 ? dpItemAvx2 : dpItemScalar);
+// 0/1 knapsack by dynamic programming over integer capacities. bestValue[c] is the best
+// value within capacity c so far; whether item i was taken at capacity c is one bit in
+// row i of the take table, so the table costs n * C bits rather than n * C doubles.
+// Values may be fractional, so the rows of best values stay doubles rather than a bitset
+// of reachable sums; the word parallelism is in dpItem, which settles a byte of the take
+// row per vector compare.
+void solveDp(const KnapsackInstance &instance, ExactResult &result)
 {
-    populationFitness = 0;
-    for (unsigned int i = 0; i < population.size(); i++)
+    int n = instance.numItems;
+    int capacity = instance.maxWeight;
+    int rowWords = (capacity + 1 + 63) / 64;
+    vector<double> bestValue(capacity + 1, 0);
+    vector<uint64_t> take((long long)n * rowWords, 0);
+    for (int i = 0; i < n; i++)
+    {
+        dpItem(bestValue.data(), capacity, (int)instance.itemWeights[i], instance.itemValues[i], take.data() + (long long)i * rowWords);
+    }
+    result.optimum = bestValue[capacity];
+    result.selected.assign(n, false);
+    int c = capacity;
+    for (int i = n - 1; i >= 0; i--)
     {
-        populationFitness += population[i].fitness;
+        if ((take[(long long)i * rowWords + c / 64] >> (c % 64)) & 1)
+        {
+            result.selected[i] = true;
+            c -= (int)instance.itemWeights[i];
+        }
     }
+    result.method = "DP";
 }
-vector<Chromosome> generatePopulation(int populationSize) 
+// Depth-first branch and bound over the items in decreasing value/weight order.
+// A branch is cut when the LP relaxation of what is left (Dantzig's bound: fill greedily,
+// then a fraction of the first item that doesn't fit) can't beat the best found so far.
+// The search is a loop over an explicit stack of take/skip decisions, one per item in
+// ratio order, so its depth is not limited by the call stack. The bound is O(log n): the
+// items that fit whole are found by binary search in prefix sums of weight and value.
+class BranchAndBound
 {
-    vector<Chromosome> population;
-    for (int i = 0; i < populationSize; i++) 
+public:
+    BranchAndBound(const KnapsackInstance &instance, long long nodeBudget) : instance(instance), order(instance.ratioOrder), nodeBudget(nodeBudget)
+    {
+        int n = instance.numItems;
+        prefixWeight.assign(n + 1, 0);
+        prefixValue.assign(n + 1, 0);
+        for (int k = 0; k < n; k++)
+        {
+            prefixWeight[k + 1] = prefixWeight[k] + instance.itemWeights[order[k]];
+            prefixValue[k + 1] = prefixValue[k] + instance.itemValues[order[k]];
+        }
+        best.assign(n, false);
+    }
+    void solve(ExactResult &result)
+    {
+        bool finished = search();
+        result.optimum = bestValue;
+        result.selected = best;
+        result.proven = finished;
+        result.method = finished ? "B&B" : "B&B, gave up after " + to_string(nodeBudget) + " nodes";
+    }
+private:
+    // Dantzig's bound for the items from k on with weight and value already taken. fitting
+    // is set to the end of the run of items from k that fit whole.
+    double bound(int k, double weight, double value, int &fitting) const
+    {
+        double room = instance.maxWeight - weight;
+        fitting = upper_bound(prefixWeight.begin() + k, prefixWeight.end(), prefixWeight[k] + room) - prefixWeight.begin() - 1;
+        value += prefixValue[fitting] - prefixValue[k];
+        if (fitting < (int)order.size())
+        {
+            int item = order[fitting];
+            value += (room - (prefixWeight[fitting] - prefixWeight[k])) * instance.itemValues[item] / instance.itemWeights[item];
+        }
+        return value;
+    }
+    // The decisions for order[0, k) plus every item from k on when takeRest is set
+    void record(int k, double value, bool takeRest)
+    {
+        bestValue = value;
+        for (int i = 0; i < (int)order.size(); i++)
+        {
+            best[order[i]] = i < k ? decisions[i] : takeRest;
+        }
+    }
+    // Returns false if the node budget ran out first
+    bool search()
     {
-        Chromosome chromosome;
-        for (int j = 0; j < numItems; j++)
+        int n = order.size();
+        // decisions[i] is 1 while the take branch of order[i] is being searched, 0 in the skip
+        // branch; weights[i] and values[i] are the totals before order[i] was decided
+        decisions.assign(n, 0);
+        vector<double> weights(n), values(n);
+        int k = 0;
+        double weight = 0, value = 0;
+        long long nodes = 0;
+        while (true)
         {
-            if (rand() % 2 == 0)
+            if (++nodes > nodeBudget)
             {
-                chromosome.genes.push_back(true);
-            } 
-            else 
+                return false;
+            }
+            int fitting = n;
+            bool leaf = k == n;
+            if (!leaf && bound(k, weight, value, fitting) > bestValue)
+            {
+                if (fitting == n)
+                {
+                    // Everything left fits, so the bound is reached by taking it all
+                    record(k, value + prefixValue[n] - prefixValue[k], true);
+                }
+                else
+                {
+                    int item = order[k];
+                    weights[k] = weight;
+                    values[k] = value;
+                    decisions[k] = weight + instance.itemWeights[item] <= instance.maxWeight;
+                    if (decisions[k])
+                    {
+                        weight += instance.itemWeights[item];
+                        value += instance.itemValues[item];
+                    }
+                    k++;
+                    continue;
+                }
+            }
+            else if (leaf && value > bestValue)
+            {
+                record(k, value, false);
+            }
+            // Back up to the deepest take branch and try skipping that item instead
+            do
+            {
+                k--;
+            } while (k >= 0 && !decisions[k]);
+            if (k < 0)
             {
-                chromosome.genes.push_back(false);
+                return true;
             }
+            decisions[k] = 0;
+            weight = weights[k];
+            value = values[k];
+            k++;
         }
-        setFitness(chromosome);
-        population.push_back(chromosome);
     }
-    return population;
-}
-Chromosome getParent() 
+    const KnapsackInstance &instance;
+    const vector<int> &order;
+    long long nodeBudget;
+    vector<double> prefixWeight, prefixValue;
+    vector<char> decisions;
+    vector<bool> best;
+    double bestValue = 0;
+};
+// DP when every weight is a whole number and the table is small enough, branch and bound
+// with at most nodeBudget nodes otherwise. A budget of 0 skips the solve.
+void solveExact(const KnapsackInstance &instance, ExactResult &result, long long nodeBudget = defaultBranchNodes)
 {
-    vector<Chromosome> selectedParents;
-    for (int i = 0; i < selectionSize; i++) 
+    if (nodeBudget <= 0)
     {
-        int randomIndex = rand() % population.size();
-        selectedParents.push_back(population[randomIndex]);
+        result = ExactResult();
+        result.proven = false;
+        result.method = "skipped";
+        return;
     }
-    Chromosome parent = selectedParents[0];
-    for (unsigned int i = 1; i < selectedParents.size(); i++) 
+    auto start = chrono::high_resolution_clock::now();
+    bool integral = true;
+    for (int i = 0; i < instance.numItems; i++)
     {
-        if (selectedParents[i].fitness > parent.fitness) 
+        if (instance.itemWeights[i] != floor(instance.itemWeights[i]) || instance.itemWeights[i] < 0)
         {
-            parent = selectedParents[i];
+            integral = false;
         }
     }
-    return parent;
-}
-pair<Chromosome, Chromosome> selectChromosones()
-{
-    Chromosome parent1 = getParent();
-    Chromosome parent2 = getParent();
-    return make_pair(parent1, parent2);
+    if (integral && instance.maxWeight < maxDpCapacity && instance.maxWeight < maxDpCells / instance.numItems)
+    {
+        solveDp(instance, result);
+    }
+    else
+    {
+        BranchAndBound(instance, nodeBudget).solve(result);
+    }
+    result.runtime = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
 }
-pair<Chromosome, Chromosome> crossover()
+// Seconds until the GA's best came within gap (a fraction) of the optimum, -1 if it never
+// did or the optimum is not known
+double timeToGap(const GAResult &result, const ExactResult &exact, double gap)
 {
-    pair<Chromosome, Chromosome> parents = selectChromosones();
-    Chromosome parent1 = parents.first;
-    Chromosome parent2 = parents.second;
-    if(rand() % 100 > crossoverRate * 100)
+    if (!exact.proven)
     {
-        return make_pair(parent1, parent2);
+        return -1;
     }
-    Chromosome child1, child2;
-    int crossoverPoint = rand() % numItems;
-    for (int i = 0; i < crossoverPoint; i++) 
+    double optimum = exact.optimum;
+    for (const pair<double, double> &improvement : result.improvements)
     {
-        child1.genes.push_back(parent1.genes[i]);
-        child2.genes.push_back(parent2.genes[i]);
+        if (improvement.second >= optimum * (1 - gap - optimumTolerance))
+        {
+            return improvement.first;
+        }
     }
-    for (unsigned int i = crossoverPoint; i < parent1.genes.size(); i++) 
+    return -1;
+}
+// Relative gap to the optimum, -1 if the optimum is not known. Gaps within rounding of
+// the optimum count as 0, so a gap of 0 and a time to optimum always go together.
+double gapToOptimum(const GAResult &result, const ExactResult &exact)
+{
+    if (!exact.proven)
     {
-        child1.genes.push_back(parent2.genes[i]);
-        child2.genes.push_back(parent1.genes[i]);
+        return -1;
     }
-    setFitness(child1);
-    setFitness(child2);
-    return make_pair(child1, child2);
+    double gap = exact.optimum == 0 ? 0 : (exact.optimum - result.fitness) / exact.optimum;
+    return gap < optimumTolerance ? 0 : gap;
 }
-void mutate(Chromosome &chromosome) 
+string algorithmName(const GAConfig &config)
 {
-    int mutationPoint = rand() % numItems;
-    chromosome.genes[mutationPoint] = !chromosome.genes[mutationPoint];
-    setFitness(chromosome);
+    string name = config.localSearchEnabled ? (config.localSearchMode == FIRST_IMPROVEMENT ? "GA-LS" : "GA-LS (best improvement)") : "GA";
+    if (config.islands > 1)
+    {
+        name += " (" + to_string(config.islands) + " islands " + (config.topology == RING ? "ring" : "complete") + ")";
+    }
+    return name;
 }
-Chromosome getBestChromosome() 
+void printResult(const KnapsackInstance &instance, const GAConfig &config, const GAResult &result, const ExactResult &exact)
 {
-    Chromosome bestChromosome = population[0];
-    for (unsigned int i = 1; i < population.size(); i++)
+    cout << endl << "Problem: " << instance.name << endl;
+    cout << "Algorithm: " << algorithmName(config) << endl;
+    cout << "Best Solution: ";
+    for (int i = 0; i < instance.numItems; i++)
     {
-        if (population[i].fitness > bestChromosome.fitness) 
+        if (result.selected[i])
         {
-            bestChromosome = population[i];
+            cout << i + 1 << " ";
         }
     }
-    return bestChromosome;
+    cout << endl << "Best Fitness: " << result.fitness << endl;
+    if (!exact.proven)
+    {
+        cout << "Known Optimum: unknown (" << exact.method << ")" << endl;
+        cout << "Gap: unknown" << endl;
+    }
+    else
+    {
+        cout << "Known Optimum: " << exact.optimum << " (" << exact.method << ")" << endl;
+        cout << "Gap: " << gapToOptimum(result, exact) * 100 << "%" << endl;
+        double toOnePercent = timeToGap(result, exact, 0.01);
+        double toOptimum = timeToGap(result, exact, 0);
+        cout << "Time to 1% gap: " << (toOnePercent < 0 ? "not reached" : to_string(toOnePercent) + " seconds") << endl;
+        cout << "Time to optimum: " << (toOptimum < 0 ? "not reached" : to_string(toOptimum) + " seconds") << endl;
+    }
+    cout << "Generations: " << result.generations << " (stopped by " << result.stopReason << ")" << endl;
+    cout << "Evaluations: " << result.evaluations << " (" << result.cacheHits << " from the cache)" << endl;
+    cout << "Runtime: " << result.runtime << " seconds" << endl;
+    cout << "Seed: " << result.seed << endl;
 }
-void localSearch(Chromosome &chromosome) 
+// One CSV row per recorded generation of one run
+void writeStats(ostream &output, const string &instanceName, const string &algorithm, const GAResult &result)
 {
-    for (unsigned int i = 0; i < chromosome.genes.size(); i++)
+    for (const GenerationStats &stats : result.stats)
     {
-        chromosome.genes[i] = !chromosome.genes[i];
-        double oldFitness = chromosome.fitness;
-        setFitness(chromosome);
+        output << instanceName << "," << algorithm << "," << result.seed << "," << stats.generation << "," << stats.seconds << ","
+               << stats.evaluations << "," << (stats.seconds > 0 ? stats.evaluations / stats.seconds : 0) << ","
+               << stats.bestFitness << "," << stats.meanFitness << "," << stats.diversity << "\n";
+    }
+}
+// Runs GA-LS and plain GA numRuns times each, all at once on a pool of threads
+// (each run single-threaded), and compares the mean best fitness with a z-test.
+void runZTest(const KnapsackInstance &instance, const ExactResult &exact, int numRuns, time_t firstSeed)
+{
+    GAConfig withLs = defaultConfig(instance, true);
+    GAConfig withoutLs = defaultConfig(instance, false);
+    vector<GAResult> results(2 * numRuns);
+    WorkerPool pool(numThreads);
+    pool.run(2 * numRuns, [&](int run)
+    {
+        // Run i with and without local search share seed firstSeed + i
+        const GAConfig &config = run % 2 == 0 ? withLs : withoutLs;
+        results[run] = runGA(instance, config, firstSeed + run / 2);
+    });
+    vector<double> fitness_with_ls(numRuns);
+    vector<double> fitness_without_ls(numRuns);
+    for (int i = 0; i < numRuns; i++)
+    {
+        printResult(instance, withLs, results[2 * i], exact);
+        printResult(instance, withoutLs, results[2 * i + 1], exact);
+        fitness_with_ls[i] = results[2 * i].fitness;
+        fitness_without_ls[i] = results[2 * i + 1].fitness;
+    }
+    double mean_with_ls = calculateMean(fitness_with_ls);
+    double mean_without_ls = calculateMean(fitness_without_ls);
+    double sd_with_ls = calculateStdDev(fitness_with_ls, mean_with_ls);
+    double sd_without_ls = calculateStdDev(fitness_without_ls, mean_without_ls);
 
-        if (chromosome.fitness <= oldFitness)
-        {
-            chromosome.genes[i] = !chromosome.genes[i];
-            chromosome.fitness = oldFitness;
-        }
+    double se_diff = sqrt((sd_with_ls * sd_with_ls / numRuns) + (sd_without_ls * sd_without_ls / numRuns));
+
+    double z_score = se_diff == 0 ? 0 : (mean_with_ls - mean_without_ls) / se_diff;
+
+    cout << "Z-Score: " << z_score << endl;
+
+    double critical_value = 1.645;
+    if (z_score > critical_value) 
+    {
+        cout << "Reject null hypothesis: the means are not equivalent." << endl;
+    } 
+    else 
+    {
+        cout << "Fail to reject null hypothesis: the means are equivalent." << endl;
     }
 }
-double runProblem(string fileName, bool localSearchEnabled, time_t seed, bool outputEnabled)
+// Whether a file starts like an instance: the binary tag, or a text header of two numbers.
+// Only the first bytes are read, so a directory of other files is cheap to sweep.
+bool looksLikeInstance(const string &fileName)
 {
-    if (localSearchEnabled)
-        maxGenerations = numItems;
-    else
-        maxGenerations = 5 * numItems;
-    auto start = chrono::high_resolution_clock::now();
-    population = generatePopulation(populationSize);
-    Chromosome bestChromosome = getBestChromosome();
-    setPopulationFitness();
-    for (int i = 0; i < maxGenerations; i++) 
+    char start[64];
+    ifstream file(fileName, ios::binary);
+    file.read(start, sizeof(start));
+    size_t size = file.gcount();
+    if (size >= sizeof(binaryTag) && memcmp(start, binaryTag, sizeof(binaryTag)) == 0)
+    {
+        return true;
+    }
+    NumberReader reader(start, start + size);
+    long long numItems;
+    double maxWeight;
+    return reader.read(numItems) && reader.read(maxWeight);
+}
+bool addInstances(const string &argument, vector<KnapsackInstance> &instances)
+{
+    vector<string> paths;
+    if (filesystem::is_directory(argument))
     {
-        vector<Chromosome> newPopulation;
-        for (int j = 0; j < populationSize/2; j++)
+        for (const filesystem::directory_entry &entry : filesystem::directory_iterator(argument))
         {
-            pair<Chromosome, Chromosome> children = crossover();
-            Chromosome child1 = children.first;
-            Chromosome child2 = children.second;
-            if (rand() % 100 < mutationRate * 100)
-            {
-                mutate(child1);
-            }
-            if (rand() % 100 < mutationRate * 100)
+            // Skip the spreadsheet of optima and anything else that isn't an instance
+            if (entry.is_regular_file() && looksLikeInstance(entry.path().string()))
             {
-                mutate(child2);
+                paths.push_back(entry.path().string());
             }
-            if (localSearchEnabled)
+        }
+        sort(paths.begin(), paths.end());
+    }
+    else if (argument.find_first_of("*?[") != string::npos)
+    {
+        glob_t matches;
+        if (glob(argument.c_str(), 0, nullptr, &matches) == 0)
+        {
+            for (size_t i = 0; i < matches.gl_pathc; i++)
             {
-                localSearch(child1);
-                localSearch(child2);
+                paths.push_back(matches.gl_pathv[i]);
             }
-            newPopulation.push_back(child1);
-            newPopulation.push_back(child2);
         }
-        population = newPopulation;
-        setPopulationFitness();
-        Chromosome newBestChromosome = getBestChromosome();
-        if (newBestChromosome.fitness == 0)
+        globfree(&matches);
+    }
+    else
+    {
+        paths.push_back(argument);
+    }
+    if (paths.empty())
+    {
+        cerr << "No instances match " << argument << "." << endl;
+        return false;
+    }
+    for (const string &path : paths)
+    {
+        instances.emplace_back();
+        if (!loadInstance(path, instances.back()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+bool parseSeeds(const string &text, vector<uint64_t> &seeds)
+{
+    stringstream stream(text);
+    string part;
+    while (getline(stream, part, ','))
+    {
+        size_t dash = part.find('-');
+        try
         {
-            Chromosome newChromosome;
-            for (int j = 0; j < numItems; j++)
+            uint64_t first = stoull(part.substr(0, dash));
+            uint64_t last = dash == string::npos ? first : stoull(part.substr(dash + 1));
+            for (uint64_t seed = first; seed <= last; seed++)
             {
-                newChromosome.genes.push_back(false);
+                seeds.push_back(seed);
             }
-            int index = rand() % population.size();
-            population.erase(population.begin() + index);
+        }
+        catch (const logic_error &)
+        {
+            cerr << "Bad seed list: " << text << endl;
+            return false;
+        }
+    }
+    return !seeds.empty();
+}
+bool parseVariants(const string &text, vector<GAConfig> &variants)
+{
+    stringstream stream(text);
+    string name;
+    while (getline(stream, name, ','))
+    {
+        GAConfig variant;
+        if (name == "ga-ls" || name == "ga-ls-best")
+        {
+            variant.localSearchEnabled = true;
+            variant.localSearchMode = name == "ga-ls" ? FIRST_IMPROVEMENT : BEST_IMPROVEMENT;
+        }
+        else if (name != "ga")
+        {
+            cerr << "Unknown variant " << name << ", expected ga, ga-ls or ga-ls-best." << endl;
+            return false;
+        }
+        variants.push_back(variant);
+    }
+    return !variants.empty();
+}
+// Quoted JSON string with quotes, backslashes and control characters escaped
+string jsonString(const string &text)
+{
+    string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            quoted += '\\';
+            quoted += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", (unsigned char)c);
+            quoted += escape;
+        }
+        else
+        {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+// Batch mode, used whenever there are command line arguments:
+//   main [files, directories or globs] [--seeds 1-30|1,5,9] [--variants ga,ga-ls,ga-ls-best]
+//        [--threads n] [--format csv|json]
+//        [--islands k] [--migration-interval m] [--migrants n] [--topology ring|complete]
+//        [--stagnation generations] [--stop-at-optimum] [--time-limit seconds]
+//        [--max-evaluations n] [--stats-file file] [--cache-mb megabytes]
+//        [--exact-nodes n] [--no-exact]
+//   main --to-binary input output    converts a text instance to the binary format
+// Every instance is loaded and solved exactly once, then every (instance, variant, seed)
+// run is spread over the threads, one thread per run. With --islands k each run starts k
+// island threads of its own, so only threads / k runs go at once. One CSV row or JSON line
+// is printed per run, in instance, variant, seed order. Branch and bound gives up after
+// --exact-nodes nodes (20 million by default) and --no-exact skips the exact solve; the
+// optimum, gap and time to optimum are then -1.
+int runBatch(int argc, char *argv[])
+{
+    if (string(argv[1]) == "--to-binary")
+    {
+        KnapsackInstance instance;
+        if (argc != 4)
+        {
+            cerr << "Usage: " << argv[0] << " --to-binary input output" << endl;
+            return 1;
+        }
+        return loadInstance(argv[2], instance) && saveBinaryInstance(argv[3], instance) ? 0 : 1;
+    }
+    vector<KnapsackInstance> instances;
+    vector<uint64_t> seeds;
+    vector<GAConfig> variants;
+    int threads = numThreads;
+    bool json = false;
+    GAConfig islandSettings;
+    bool stopAtOptimum = false;
+    long long exactNodes = defaultBranchNodes;
+    string statsFileName;
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "--seeds" && i + 1 < argc)
+        {
+            if (!parseSeeds(argv[++i], seeds))
+                return 1;
+        }
+        else if (argument == "--variants" && i + 1 < argc)
+        {
+            if (!parseVariants(argv[++i], variants))
+                return 1;
+        }
+        else if (argument == "--threads" && i + 1 < argc)
+        {
+            threads = max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--islands" && i + 1 < argc)
+        {
+            islandSettings.islands = max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--migration-interval" && i + 1 < argc)
+        {
+            islandSettings.migrationInterval = max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--migrants" && i + 1 < argc)
+        {
+            islandSettings.migrants = max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--topology" && i + 1 < argc)
+        {
+            islandSettings.topology = string(argv[++i]) == "complete" ? COMPLETE : RING;
+        }
+        else if (argument == "--stagnation" && i + 1 < argc)
+        {
+            islandSettings.stagnationLimit = max(0, atoi(argv[++i]));
+        }
+        else if (argument == "--stop-at-optimum")
+        {
+            stopAtOptimum = true;
+        }
+        else if (argument == "--exact-nodes" && i + 1 < argc)
+        {
+            exactNodes = max(0LL, atoll(argv[++i]));
+        }
+        else if (argument == "--no-exact")
+        {
+            exactNodes = 0;
+        }
+        else if (argument == "--time-limit" && i + 1 < argc)
+        {
+            islandSettings.timeLimit = max(0.0, atof(argv[++i]));
+        }
+        else if (argument == "--max-evaluations" && i + 1 < argc)
+        {
+            islandSettings.maxEvaluations = max(0LL, atoll(argv[++i]));
+        }
+        else if (argument == "--cache-mb" && i + 1 < argc)
+        {
+            islandSettings.cacheBytes = (size_t)max(0, atoi(argv[++i])) << 20;
+        }
+        else if (argument == "--stats-file" && i + 1 < argc)
+        {
+            statsFileName = argv[++i];
+        }
+        else if (argument == "--format" && i + 1 < argc)
+        {
+            json = string(argv[++i]) == "json";
+        }
+        else if (!addInstances(argument, instances))
+        {
+            return 1;
+        }
+    }
+    if (instances.empty())
+    {
+        cerr << "No instances given." << endl;
+        return 1;
+    }
+    if (seeds.empty())
+        parseSeeds("1-30", seeds);
+    if (variants.empty())
+        parseVariants("ga,ga-ls", variants);
 
-            population.push_back(newChromosome);
+    vector<ExactResult> exact(instances.size());
+    // Each instance's settings for each variant; runs only read them
+    vector<GAConfig> configs;
+    for (size_t i = 0; i < instances.size(); i++)
+    {
+        solveExact(instances[i], exact[i], exactNodes);
+        for (const GAConfig &variant : variants)
+        {
+            GAConfig config = defaultConfig(instances[i], variant.localSearchEnabled);
+            config.localSearchMode = variant.localSearchMode;
+            config.islands = islandSettings.islands;
+            config.migrationInterval = islandSettings.migrationInterval;
+            config.migrants = islandSettings.migrants;
+            config.topology = islandSettings.topology;
+            config.stagnationLimit = islandSettings.stagnationLimit;
+            config.timeLimit = islandSettings.timeLimit;
+            config.maxEvaluations = islandSettings.maxEvaluations;
+            config.cacheBytes = islandSettings.cacheBytes;
+            config.targetFitness = stopAtOptimum && exact[i].proven ? exact[i].optimum * (1 - optimumTolerance) : 0;
+            config.recordStats = !statsFileName.empty();
+            configs.push_back(config);
         }
-        if (newBestChromosome.fitness > bestChromosome.fitness)
+    }
+    int runsPerConfig = seeds.size();
+    vector<GAResult> results(configs.size() * runsPerConfig);
+    WorkerPool pool(max(1, threads / islandSettings.islands));
+    pool.run(results.size(), [&](int run)
+    {
+        int config = run / runsPerConfig;
+        results[run] = runGA(instances[config / variants.size()], configs[config], seeds[run % runsPerConfig]);
+    });
+
+    if (!json)
+        cout << "instance,algorithm,seed,fitness,optimum,gap,runtime,time_to_optimum,generations,evaluations,cache_hits,stop\n";
+    for (size_t run = 0; run < results.size(); run++)
+    {
+        int config = run / runsPerConfig;
+        const KnapsackInstance &instance = instances[config / variants.size()];
+        const ExactResult &optimum = exact[config / variants.size()];
+        const GAResult &result = results[run];
+        double gap = gapToOptimum(result, optimum);
+        double toOptimum = timeToGap(result, optimum, 0);
+        double knownOptimum = optimum.proven ? optimum.optimum : -1;
+        if (json)
+        {
+            cout << "{\"instance\": " << jsonString(instance.name) << ", \"algorithm\": " << jsonString(algorithmName(configs[config]))
+                 << ", \"seed\": " << result.seed << ", \"fitness\": " << result.fitness << ", \"optimum\": " << knownOptimum
+                 << ", \"gap\": " << gap << ", \"runtime\": " << result.runtime << ", \"time_to_optimum\": " << toOptimum
+                 << ", \"generations\": " << result.generations << ", \"evaluations\": " << result.evaluations << ", \"cache_hits\": " << result.cacheHits << ", \"stop\": " << jsonString(result.stopReason) << "}\n";
+        }
+        else
         {
-            bestChromosome = newBestChromosome;
+            cout << instance.name << "," << algorithmName(configs[config]) << "," << result.seed << "," << result.fitness << ","
+                 << knownOptimum << "," << gap << "," << result.runtime << "," << toOptimum << ","
+                 << result.generations << "," << result.evaluations << "," << result.cacheHits << "," << result.stopReason << "\n";
         }
-        if(!outputEnabled)
-            cout << "Generation " << i + 1 << " Best Chromosome Fitness: " << bestChromosome.fitness << endl;
     }
-    auto end = chrono::high_resolution_clock::now();
-    auto elapsed = chrono::duration<double>(end - start);
-    cout << endl << "Problem: " << fileName << endl;
-    cout << "Algorithm: " << (localSearchEnabled ? "GA-LS" : "GA") << endl;
-    cout << "Best Solution: ";
-    for (unsigned int i = 0; i < bestChromosome.genes.size(); i++)
+    if (!statsFileName.empty())
     {
-        if (bestChromosome.genes[i])
+        ofstream statsFile(statsFileName);
+        statsFile << "instance,algorithm,seed,generation,seconds,evaluations,evaluations_per_second,best_fitness,mean_fitness,diversity\n";
+        for (size_t run = 0; run < results.size(); run++)
         {
-            cout << i + 1 << " ";
+            int config = run / runsPerConfig;
+            writeStats(statsFile, instances[config / variants.size()].name, algorithmName(configs[config]), results[run]);
+        }
+        if (!statsFile)
+        {
+            cerr << "Failed to write " << statsFileName << "." << endl;
+            return 1;
         }
     }
-    cout << endl << "Known Optimum: " << bestChromosome.fitness << endl;
-    cout << "Runtime: " << elapsed.count() << " seconds" << endl;
-    cout << "Seed: " << seed << endl;
-    return bestChromosome.fitness;
+    return 0;
 }
-int main() 
+int main(int argc, char *argv[]) 
 {
+    if (argc > 1)
+        return runBatch(argc, argv);
     time_t seed;
     cout << "Z-Test [y/n]: ";
     char zTestOption;
     cin >> zTestOption;
     bool zTestEnabled = zTestOption == 'y' || zTestOption == 'Y';
     bool localSearchEnabled = false;
+    LocalSearchMode localSearchMode = FIRST_IMPROVEMENT;
     if (!zTestEnabled)
     {
         cout << "Enter seed: ";
         cin >> seed;
         // seed = time(0);
-        srand(seed);
         cout << "Knapsack Problem" << endl;
         cout << "Local Search [y/n]: ";
         char localSearchOption;
         cin >> localSearchOption;
         localSearchEnabled = localSearchOption == 'y' || localSearchOption == 'Y';
+        if (localSearchEnabled)
+        {
+            cout << "Best improvement [y/n]: ";
+            char bestImprovementOption;
+            cin >> bestImprovementOption;
+            if (bestImprovementOption == 'y' || bestImprovementOption == 'Y')
+                localSearchMode = BEST_IMPROVEMENT;
+        }
     }
     string fileNames[] = {"f1_l-d_kp_10_269", "f2_l-d_kp_20_878", "f3_l-d_kp_4_20", "f4_l-d_kp_4_11", "f5_l-d_kp_15_375", "f6_l-d_kp_10_60", "f7_l-d_kp_7_50", "f8_l-d_kp_23_10000", "f9_l-d_kp_5_80", "f10_l-d_kp_20_879", "knapPI_1_100_1000_1"};
     cout << "options" << endl;
@@ -292,53 +2036,33 @@ int main()
         return 1;
     }
 
-    ifstream inputFile(fileName);
     cout << "File name: " << fileName << endl;
-    if (!inputFile) 
+    KnapsackInstance instance;
+    if (!loadInstance(fileName, instance))
     {
-        cerr << "Failed to open the file." << endl;
         return 1;
     }
-    inputFile >> numItems >> maxWeight;
-    allItems.resize(numItems);
-    for (int i = 0; i < numItems; i++)
+    ExactResult exact;
+    solveExact(instance, exact);
+    if (!zTestEnabled)
     {
-        inputFile >> allItems[i].value >> allItems[i].weight;
+        GAConfig config = defaultConfig(instance, localSearchEnabled);
+        config.localSearchMode = localSearchMode;
+        config.threads = numThreads;
+        config.recordStats = true;
+        GAResult result = runGA(instance, config, seed);
+        // The run itself prints nothing, the generations are written out together afterwards
+        for (const GenerationStats &stats : result.stats)
+        {
+            if (stats.generation > 0)
+                cout << "Generation " << stats.generation << " Best Chromosome Fitness: " << stats.bestFitness << "\n";
+        }
+        printResult(instance, config, result, exact);
     }
-    inputFile.close();
-    mutationRate = min(baseMutationRate * numItems, maxMutationRate);
-    if (!zTestEnabled)
-        runProblem(fileName, localSearchEnabled, seed, false);
     // Used for Z testing
     else
     {
-        for (int i = 0; i < numRuns; i++)
-        {
-            seed = time(0) + i;
-            srand(seed);
-            fitness_with_ls[i] = runProblem(fileName, true, seed, true);
-            fitness_without_ls[i] = runProblem(fileName, false, seed, true);
-        }
-        double mean_with_ls = calculateMean(fitness_with_ls);
-        double mean_without_ls = calculateMean(fitness_without_ls);
-        double sd_with_ls = calculateStdDev(fitness_with_ls, mean_with_ls);
-        double sd_without_ls = calculateStdDev(fitness_without_ls, mean_without_ls);
-
-        double se_diff = sqrt((sd_with_ls * sd_with_ls / numRuns) + (sd_without_ls * sd_without_ls / numRuns));
-
-        double z_score = se_diff == 0 ? 0 : (mean_with_ls - mean_without_ls) / se_diff;
-
-        cout << "Z-Score: " << z_score << endl;
-
-        double critical_value = 1.645;
-        if (z_score > critical_value) 
-        {
-            cout << "Reject null hypothesis: the means are not equivalent." << endl;
-        } 
-        else 
-        {
-            cout << "Fail to reject null hypothesis: the means are equivalent." << endl;
-        }
+        runZTest(instance, exact, 30, time(0));
     }
 
     return 0;
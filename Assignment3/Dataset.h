@@ -0,0 +1,206 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <algorithm>
+
+// Allocator for vectors whose data has to start on a 64-byte boundary so the SIMD kernels can use aligned loads
+template <typename T>
+struct AlignedAllocator
+{
+    typedef T value_type;
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U> &) {}
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(64)));
+    }
+    void deallocate(T *p, size_t)
+    {
+        ::operator delete(p, std::align_val_t(64));
+    }
+    bool operator==(const AlignedAllocator &) const { return true; }
+    bool operator!=(const AlignedAllocator &) const { return false; }
+};
+typedef std::vector<double, AlignedAllocator<double>> AlignedVector;
+
+// Rows are padded to a multiple of 8 doubles (one 64-byte line) so every row starts aligned
+// and the kernels never need a tail loop
+inline int paddedSize(int n)
+{
+    return (n + 7) / 8 * 8;
+}
+
+// One feature down a block of rows: every stride-th double from data
+struct ColumnView
+{
+    const double *data = nullptr;
+    size_t rows = 0;
+    int stride = 0;
+    double operator[](size_t i) const { return data[i * stride]; }
+    size_t size() const { return rows; }
+};
+
+struct ColumnStats
+{
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double stddev = 0;
+};
+
+// A run of consecutive rows of a Dataset. Views only point into the dataset's buffers,
+// so they are cheap to pass around and stay valid as long as the dataset does.
+struct DatasetView
+{
+    const double *data = nullptr;
+    const double *labels = nullptr;
+    size_t rows = 0;
+    int columns = 0;
+    int stride = 0;
+
+    size_t size() const { return rows; }
+    const double *row(size_t i) const { return data + i * stride; }
+    double label(size_t i) const { return labels[i]; }
+    ColumnView column(int c) const { return {data + c, rows, stride}; }
+    DatasetView slice(size_t first, size_t count) const
+    {
+        return {data + first * stride, labels + first, count, columns, stride};
+    }
+    std::vector<ColumnStats> columnStats() const
+    {
+        std::vector<ColumnStats> stats(columns);
+        for (int c = 0; c < columns; c++)
+        {
+            ColumnView values = column(c);
+            if (rows == 0)
+            {
+                continue;
+            }
+            ColumnStats &s = stats[c];
+            s.min = s.max = values[0];
+            double sum = 0;
+            for (size_t i = 0; i < rows; i++)
+            {
+                s.min = std::min(s.min, values[i]);
+                s.max = std::max(s.max, values[i]);
+                sum += values[i];
+            }
+            s.mean = sum / rows;
+            double squares = 0;
+            for (size_t i = 0; i < rows; i++)
+            {
+                squares += (values[i] - s.mean) * (values[i] - s.mean);
+            }
+            s.stddev = std::sqrt(squares / rows);
+        }
+        return stats;
+    }
+};
+
+// Feature rows with a label in the last CSV column. The features live in one buffer, row
+// after row, each padded with zeros to paddedSize(columns) and starting on a 64-byte
+// line, so a run of rows is exactly the input matrix the NN kernels want.
+class Dataset
+{
+public:
+    std::vector<std::string> names;
+    int columns = 0;
+    int stride = 0;
+    size_t rows = 0;
+    AlignedVector data;
+    std::vector<double> labels;
+
+    DatasetView view() const
+    {
+        return {data.data(), labels.data(), rows, columns, stride};
+    }
+    operator DatasetView() const
+    {
+        return view();
+    }
+    // Shifts every feature to zero mean and unit deviation under the given stats, usually
+    // the training set's so the test set is scaled the same way. Constant columns are only centred.
+    void standardise(const std::vector<ColumnStats> &stats)
+    {
+        for (size_t i = 0; i < rows; i++)
+        {
+            double *row = data.data() + i * stride;
+            for (int c = 0; c < columns; c++)
+            {
+                row[c] -= stats[c].mean;
+                if (stats[c].stddev > 0)
+                {
+                    row[c] /= stats[c].stddev;
+                }
+            }
+        }
+    }
+};
+
+// Reads a CSV with a header line, features first and the label last
+inline bool loadDataset(const std::string &filename, Dataset &dataset)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        std::cerr << "Unable to open file " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    getline(file, line);
+    dataset = Dataset();
+    size_t start = 0;
+    while (true)
+    {
+        size_t comma = line.find(',', start);
+        dataset.names.push_back(line.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+        if (comma == std::string::npos)
+        {
+            break;
+        }
+        start = comma + 1;
+    }
+    dataset.columns = (int)dataset.names.size() - 1;
+    dataset.stride = paddedSize(dataset.columns);
+    while (getline(file, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+        dataset.data.resize((dataset.rows + 1) * dataset.stride, 0);
+        double *row = dataset.data.data() + dataset.rows * dataset.stride;
+        const char *p = line.c_str();
+        for (int c = 0; c <= dataset.columns; c++)
+        {
+            char *end;
+            double value = strtod(p, &end);
+            if (end == p)
+            {
+                std::cerr << filename << ": bad value on data row " << dataset.rows + 1 << std::endl;
+                return false;
+            }
+            if (c < dataset.columns)
+            {
+                row[c] = value;
+            }
+            else
+            {
+                dataset.labels.push_back(value);
+            }
+            p = *end == ',' ? end + 1 : end;
+        }
+        dataset.rows++;
+    }
+    return true;
+}
+
+#endif
@@ -4,9 +4,8 @@
 #include <cstdlib>
 #include <ctime>
 #include <utility>
-#include <sstream>
-#include <fstream>
 #include <chrono>
+#include "Dataset.h"
 
 using namespace std;
 
@@ -35,7 +34,7 @@ struct Metrics
     double fMeasure;
 };
 
-double evaluate(Node *node, const vector<double> &inputs)
+double evaluate(Node *node, const double *inputs)
 {
     if (node->type == TERMINAL)
     {
@@ -58,13 +57,13 @@ double evaluate(Node *node, const vector<double> &inputs)
     }
 }
 
-Metrics calculateMetrics(Node *bestTree, const vector<vector<double>> &testInputs, const vector<double> &testOutputs)
+Metrics calculateMetrics(Node *bestTree, const DatasetView &testData)
 {
     int TP = 0, TN = 0, FP = 0, FN = 0;
-    for (size_t i = 0; i < testInputs.size(); ++i)
+    for (size_t i = 0; i < testData.size(); ++i)
     {
-        double predictedOutput = round(evaluate(bestTree, testInputs[i]));
-        double actualOutput = testOutputs[i];
+        double predictedOutput = round(evaluate(bestTree, testData.row(i)));
+        double actualOutput = testData.label(i);
         if (predictedOutput == actualOutput)
         {
             if (predictedOutput == 1)
@@ -117,13 +116,13 @@ vector<Node *> initializePopulation(int populationSize, int maxDepth)
     return population;
 }
 
-double fitness(Node *tree, const vector<vector<double>> &data, const vector<double> &outputs)
+double fitness(Node *tree, const DatasetView &data)
 {
     double totalError = 0;
     for (size_t i = 0; i < data.size(); ++i)
     {
-        double result = evaluate(tree, data[i]);
-        totalError += pow(result - outputs[i], 2);
+        double result = evaluate(tree, data.row(i));
+        totalError += pow(result - data.label(i), 2);
     }
     return totalError / data.size();
 }
@@ -207,14 +206,14 @@ void mutate(Node *node, int maxDepth)
     }
 }
 
-void evolve(vector<Node *> &population, const vector<vector<double>> &data, const vector<double> &outputs, int generations, double mutationRate)
+void evolve(vector<Node *> &population, const DatasetView &data, int generations, double mutationRate)
 {
     for (int g = 0; g < generations; ++g)
     {
         vector<double> fitnesses;
         for (Node *tree : population)
         {
-            fitnesses.push_back(fitness(tree, data, outputs));
+            fitnesses.push_back(fitness(tree, data));
         }
 
         vector<Node *> newPopulation;
@@ -237,64 +236,21 @@ void evolve(vector<Node *> &population, const vector<vector<double>> &data, cons
         population = newPopulation;
 
         Node *bestTree = population[0];
-        double bestFitness = fitness(bestTree, data, outputs);
+        double bestFitness = fitness(bestTree, data);
         for (Node *tree : population)
         {
-            double currentFitness = fitness(tree, data, outputs);
+            double currentFitness = fitness(tree, data);
             if (currentFitness < bestFitness)
             {
                 bestTree = tree;
                 bestFitness = currentFitness;
             }
         }
-        Metrics metrics = calculateMetrics(bestTree, data, outputs);
+        Metrics metrics = calculateMetrics(bestTree, data);
         cout << "Generation " << g + 1 << " Training Accuracy: " << metrics.accuracy * 100 << "%" << endl;
     }
 }
 
-vector<string> split(const string &s, char delimiter)
-{
-    vector<string> tokens;
-    string token;
-    istringstream tokenStream(s);
-    while (getline(tokenStream, token, delimiter))
-    {
-        tokens.push_back(token);
-    }
-    return tokens;
-}
-
-pair<vector<vector<double>>, vector<double>> readData(const string &filename)
-{
-    ifstream file(filename);
-    vector<vector<double>> inputs;
-    vector<double> outputs;
-
-    if (!file.is_open())
-    {
-        cout << "Unable to open file" << endl;
-        return make_pair(inputs, outputs);
-    }
-
-    string line;
-    getline(file, line);
-    while (getline(file, line))
-    {
-        vector<string> tokens = split(line, ',');
-        vector<double> input;
-        for (size_t i = 0; i < tokens.size() - 1; i++)
-        {
-            input.push_back(stod(tokens[i]));
-        }
-        inputs.push_back(input);
-        outputs.push_back(stod(tokens.back()));
-    }
-
-    file.close();
-
-    return make_pair(inputs, outputs);
-}
-
 void printTree(Node *node)
 {
     if (node == nullptr)
@@ -321,13 +277,11 @@ int main()
     int seed;
     cin >> seed;
     srand(seed);
-    pair<vector<vector<double>>, vector<double>> trainingData = readData("mushroom_train.csv");
-    pair<vector<vector<double>>, vector<double>> testData = readData("mushroom_test.csv");
-
-    vector<vector<double>> trainInputs = trainingData.first;
-    vector<double> trainOutputs = trainingData.second;
-    vector<vector<double>> testInputs = testData.first;
-    vector<double> testOutputs = testData.second;
+    Dataset trainingData, testData;
+    if (!loadDataset("mushroom_train.csv", trainingData) || !loadDataset("mushroom_test.csv", testData))
+    {
+        return 1;
+    }
 
     int populationSize = 100;
     int maxDepth = 6;
@@ -336,13 +290,13 @@ int main()
     auto start = chrono::high_resolution_clock::now();
     vector<Node *> population = initializePopulation(populationSize, maxDepth);
 
-    evolve(population, trainInputs, trainOutputs, generations, mutationRate);
+    evolve(population, trainingData, generations, mutationRate);
 
     Node *bestTree = population[0];
-    double bestFitness = fitness(bestTree, testInputs, testOutputs);
+    double bestFitness = fitness(bestTree, testData);
     for (Node *tree : population)
     {
-        double currentFitness = fitness(tree, testInputs, testOutputs);
+        double currentFitness = fitness(tree, testData);
         if (currentFitness < bestFitness)
         {
             bestTree = tree;
@@ -354,7 +308,7 @@ int main()
     cout << "Best tree: ";
     printTree(bestTree);
     cout << endl << "Time taken: " << duration.count() << "ms" << endl;
-    Metrics metrics = calculateMetrics(bestTree, testInputs, testOutputs);
+    Metrics metrics = calculateMetrics(bestTree, testData);
     cout << "Accuracy: " << metrics.accuracy * 100 << "%" << endl;
     cout << "Specificity: " << metrics.specificity << endl;
     cout << "Sensitivity: " << metrics.sensitivity << endl;
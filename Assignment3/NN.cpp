@@ -1,159 +1,564 @@
 #include <iostream>
 #include <fstream>
-#include <sstream>
 #include <vector>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
 #include <chrono>
+#include <immintrin.h>
+#include "Dataset.h"
 
 using namespace std;
 
-class Neuron 
+// y[r] = row r of weights . x, for a row-major matrix with the given stride.
+// x must be padded with zeros to stride.
+void gemvScalar(const double *weights, int rows, int stride, const double *x, double *y)
 {
-public:
-    double error;
-    double value;
-    double bias;
-    vector<double> weights;
-};
+    for (int r = 0; r < rows; r++)
+    {
+        const double *row = weights + (size_t)r * stride;
+        double sum = 0;
+        for (int k = 0; k < stride; k++)
+        {
+            sum += row[k] * x[k];
+        }
+        y[r] = sum;
+    }
+}
+__attribute__((target("avx2,fma"))) void gemvAvx2(const double *weights, int rows, int stride, const double *x, double *y)
+{
+    for (int r = 0; r < rows; r++)
+    {
+        const double *row = weights + (size_t)r * stride;
+        __m256d low = _mm256_setzero_pd();
+        __m256d high = _mm256_setzero_pd();
+        for (int k = 0; k < stride; k += 8)
+        {
+            low = _mm256_fmadd_pd(_mm256_load_pd(row + k), _mm256_load_pd(x + k), low);
+            high = _mm256_fmadd_pd(_mm256_load_pd(row + k + 4), _mm256_load_pd(x + k + 4), high);
+        }
+        __m256d sum = _mm256_add_pd(low, high);
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+        y[r] = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+}
+__attribute__((target("avx512f"))) void gemvAvx512(const double *weights, int rows, int stride, const double *x, double *y)
+{
+    for (int r = 0; r < rows; r++)
+    {
+        const double *row = weights + (size_t)r * stride;
+        __m512d sum = _mm512_setzero_pd();
+        for (int k = 0; k < stride; k += 8)
+        {
+            sum = _mm512_fmadd_pd(_mm512_load_pd(row + k), _mm512_load_pd(x + k), sum);
+        }
+        y[r] = _mm512_reduce_add_pd(sum);
+    }
+}
+// Picks the widest kernel this CPU supports
+typedef void (*GemvFunction)(const double *, int, int, const double *, double *);
+GemvFunction chooseGemv()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return gemvAvx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        return gemvAvx2;
+    }
+    return gemvScalar;
+}
+GemvFunction gemv = chooseGemv();
 
-class Layer 
+// The sigmoid is most of the work in a small network, so it gets kernels too:
+// x[j] = sigmoid(x[j] + bias[j]), and delta[j] *= the network's sigmoidDerivative(value[j])
+double sigmoidScalar(double x)
 {
-public:
-    vector<Neuron> neurons;
-};
+    return 1.0 / (1.0 + exp(-x));
+}
+void sigmoidRowScalar(double *x, const double *bias, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        x[j] = sigmoidScalar(x[j] + bias[j]);
+    }
+}
+void derivativeRowScalar(double *delta, const double *value, int n)
+{
+    for (int j = 0; j < n; j++)
+    {
+        double sigmoidValue = sigmoidScalar(value[j]);
+        delta[j] *= sigmoidValue * (1 - sigmoidValue);
+    }
+}
+// 1/k! for the exp kernels' Taylor series
+const double inverseFactorials[14] = {1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320,
+    1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800};
+// e^x = 2^n e^r with n = round(x / ln 2) and |r| <= ln 2 / 2; e^r from the series up to r^13
+// is good to about an ulp. x is clamped so the result stays a normal double.
+__attribute__((target("avx512f"))) __m512d exp512(__m512d x)
+{
+    x = _mm512_min_pd(_mm512_max_pd(x, _mm512_set1_pd(-700)), _mm512_set1_pd(709));
+    __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(1.90821492927058770002e-10), r);
+    __m512d p = _mm512_set1_pd(inverseFactorials[13]);
+    for (int k = 12; k >= 0; k--)
+    {
+        p = _mm512_fmadd_pd(p, r, _mm512_set1_pd(inverseFactorials[k]));
+    }
+    return _mm512_scalef_pd(p, n);
+}
+// Below -708 the answer is set to 0 rather than left as the subnormal the clamped exp
+// would give: subnormals are very slow and would spread through the deltas and weights.
+__attribute__((target("avx512f"))) __m512d sigmoid512(__m512d x)
+{
+    __m512d one = _mm512_set1_pd(1);
+    __m512d result = _mm512_div_pd(one, _mm512_add_pd(one, exp512(_mm512_sub_pd(_mm512_setzero_pd(), x))));
+    return _mm512_maskz_mov_pd(_mm512_cmp_pd_mask(x, _mm512_set1_pd(-708), _CMP_GE_OQ), result);
+}
+__attribute__((target("avx512f"))) void sigmoidRowAvx512(double *x, const double *bias, int n)
+{
+    for (int j = 0; j < n; j += 8)
+    {
+        __mmask8 mask = n - j >= 8 ? 0xFF : (1 << (n - j)) - 1;
+        __m512d sum = _mm512_add_pd(_mm512_maskz_loadu_pd(mask, x + j), _mm512_maskz_loadu_pd(mask, bias + j));
+        _mm512_mask_storeu_pd(x + j, mask, sigmoid512(sum));
+    }
+}
+__attribute__((target("avx512f"))) void derivativeRowAvx512(double *delta, const double *value, int n)
+{
+    for (int j = 0; j < n; j += 8)
+    {
+        __mmask8 mask = n - j >= 8 ? 0xFF : (1 << (n - j)) - 1;
+        __m512d sigmoidValue = sigmoid512(_mm512_maskz_loadu_pd(mask, value + j));
+        __m512d derivative = _mm512_mul_pd(sigmoidValue, _mm512_sub_pd(_mm512_set1_pd(1), sigmoidValue));
+        _mm512_mask_storeu_pd(delta + j, mask, _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, delta + j), derivative));
+    }
+}
+__attribute__((target("avx2,fma"))) __m256d exp256(__m256d x)
+{
+    x = _mm256_min_pd(_mm256_max_pd(x, _mm256_set1_pd(-700)), _mm256_set1_pd(709));
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(6.93147180369123816490e-01), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(1.90821492927058770002e-10), r);
+    __m256d p = _mm256_set1_pd(inverseFactorials[13]);
+    for (int k = 12; k >= 0; k--)
+    {
+        p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(inverseFactorials[k]));
+    }
+    // 2^n built straight in the exponent bits: adding 1.5 * 2^52 leaves n in the low bits
+    __m256d magic = _mm256_set1_pd(0x1.8p52);
+    __m256i exponent = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, magic)), _mm256_castpd_si256(magic));
+    __m256d scale = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52));
+    return _mm256_mul_pd(p, scale);
+}
+__attribute__((target("avx2,fma"))) __m256d sigmoid256(__m256d x)
+{
+    __m256d one = _mm256_set1_pd(1);
+    __m256d result = _mm256_div_pd(one, _mm256_add_pd(one, exp256(_mm256_sub_pd(_mm256_setzero_pd(), x))));
+    return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(-708), _CMP_GE_OQ), result);
+}
+__attribute__((target("avx2,fma"))) void sigmoidRowAvx2(double *x, const double *bias, int n)
+{
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        _mm256_storeu_pd(x + j, sigmoid256(_mm256_add_pd(_mm256_loadu_pd(x + j), _mm256_loadu_pd(bias + j))));
+    }
+    sigmoidRowScalar(x + j, bias + j, n - j);
+}
+__attribute__((target("avx2,fma"))) void derivativeRowAvx2(double *delta, const double *value, int n)
+{
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    {
+        __m256d sigmoidValue = sigmoid256(_mm256_loadu_pd(value + j));
+        __m256d derivative = _mm256_mul_pd(sigmoidValue, _mm256_sub_pd(_mm256_set1_pd(1), sigmoidValue));
+        _mm256_storeu_pd(delta + j, _mm256_mul_pd(_mm256_loadu_pd(delta + j), derivative));
+    }
+    derivativeRowScalar(delta + j, value + j, n - j);
+}
+typedef void (*RowFunction)(double *, const double *, int);
+RowFunction sigmoidRow = gemv == gemvAvx512 ? sigmoidRowAvx512 : (gemv == gemvAvx2 ? sigmoidRowAvx2 : sigmoidRowScalar);
+RowFunction derivativeRow = gemv == gemvAvx512 ? derivativeRowAvx512 : (gemv == gemvAvx2 ? derivativeRowAvx2 : derivativeRowScalar);
 
-class NeuralNetwork 
+// Matrix products for the batched passes go through one blocked GEMM, C += alpha * A * B.
+// Blocks of A and B are packed into contiguous strips (which also takes care of any
+// transposing) and a micro-kernel works out a 6 x 8 tile of C in registers, running down
+// the whole packed depth of a block before touching C.
+const int microRows = 6;
+const int microColumns = 8;
+const int depthBlock = 256;  // a packed strip of B (depthBlock x 8) stays in L1
+const int rowBlock = 72;     // a packed block of A (rowBlock x depthBlock) stays in L2
+const int columnBlock = 512; // a packed block of B (depthBlock x columnBlock) stays in L3
+
+// c[r * ldc + j] += sum over p of a[p * microRows + r] * b[p * microColumns + j] for a tile of
+// packed strips. The loops over a tile's rows are unrolled so the sums stay in registers.
+void tileScalar(int depth, const double *a, const double *b, double *c, int ldc)
 {
-private:
-    double learningRate = 0.8;
-public:
-    vector<Layer> layers;
-    double sigmoid(double x) 
+    double sum[microRows][microColumns] = {};
+    for (int p = 0; p < depth; p++)
     {
-        return 1.0 / (1.0 + exp(-x));
+        #pragma GCC unroll 6
+        for (int r = 0; r < microRows; r++)
+        {
+            for (int j = 0; j < microColumns; j++)
+            {
+                sum[r][j] += a[p * microRows + r] * b[p * microColumns + j];
+            }
+        }
     }
-    double sigmoidDerivative(double x) 
+    #pragma GCC unroll 6
+    for (int r = 0; r < microRows; r++)
     {
-        double sigmoidValue = sigmoid(x);
-        return sigmoidValue * (1 - sigmoidValue);
+        for (int j = 0; j < microColumns; j++)
+        {
+            c[(size_t)r * ldc + j] += sum[r][j];
+        }
+    }
+}
+// One row of eight: c[j] += sum over p of a[p * aStep] * b[p * ldb + j], for the rows left
+// over at the end of a block and for unpacked products of a few rows
+void rowScalar(int depth, const double *a, int aStep, const double *b, int ldb, double *c)
+{
+    double sum[microColumns] = {};
+    for (int p = 0; p < depth; p++)
+    {
+        for (int j = 0; j < microColumns; j++)
+        {
+            sum[j] += a[p * aStep] * b[p * ldb + j];
+        }
+    }
+    for (int j = 0; j < microColumns; j++)
+    {
+        c[j] += sum[j];
+    }
+}
+__attribute__((target("avx2,fma"))) void tileAvx2(int depth, const double *a, const double *b, double *c, int ldc)
+{
+    __m256d low[microRows], high[microRows];
+    #pragma GCC unroll 6
+    for (int r = 0; r < microRows; r++)
+    {
+        low[r] = high[r] = _mm256_setzero_pd();
+    }
+    for (int p = 0; p < depth; p++)
+    {
+        __m256d bLow = _mm256_load_pd(b + p * microColumns);
+        __m256d bHigh = _mm256_load_pd(b + p * microColumns + 4);
+        #pragma GCC unroll 6
+        for (int r = 0; r < microRows; r++)
+        {
+            __m256d element = _mm256_broadcast_sd(a + p * microRows + r);
+            low[r] = _mm256_fmadd_pd(element, bLow, low[r]);
+            high[r] = _mm256_fmadd_pd(element, bHigh, high[r]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (int r = 0; r < microRows; r++)
+    {
+        double *row = c + (size_t)r * ldc;
+        _mm256_storeu_pd(row, _mm256_add_pd(_mm256_loadu_pd(row), low[r]));
+        _mm256_storeu_pd(row + 4, _mm256_add_pd(_mm256_loadu_pd(row + 4), high[r]));
+    }
+}
+__attribute__((target("avx2,fma"))) void rowAvx2(int depth, const double *a, int aStep, const double *b, int ldb, double *c)
+{
+    __m256d low = _mm256_setzero_pd();
+    __m256d high = _mm256_setzero_pd();
+    for (int p = 0; p < depth; p++)
+    {
+        __m256d element = _mm256_broadcast_sd(a + p * aStep);
+        low = _mm256_fmadd_pd(element, _mm256_loadu_pd(b + (size_t)p * ldb), low);
+        high = _mm256_fmadd_pd(element, _mm256_loadu_pd(b + (size_t)p * ldb + 4), high);
+    }
+    _mm256_storeu_pd(c, _mm256_add_pd(_mm256_loadu_pd(c), low));
+    _mm256_storeu_pd(c + 4, _mm256_add_pd(_mm256_loadu_pd(c + 4), high));
+}
+__attribute__((target("avx512f"))) void tileAvx512(int depth, const double *a, const double *b, double *c, int ldc)
+{
+    __m512d sum[microRows];
+    #pragma GCC unroll 6
+    for (int r = 0; r < microRows; r++)
+    {
+        sum[r] = _mm512_setzero_pd();
+    }
+    for (int p = 0; p < depth; p++)
+    {
+        __m512d row = _mm512_load_pd(b + p * microColumns);
+        #pragma GCC unroll 6
+        for (int r = 0; r < microRows; r++)
+        {
+            sum[r] = _mm512_fmadd_pd(_mm512_set1_pd(a[p * microRows + r]), row, sum[r]);
+        }
+    }
+    #pragma GCC unroll 6
+    for (int r = 0; r < microRows; r++)
+    {
+        double *row = c + (size_t)r * ldc;
+        _mm512_storeu_pd(row, _mm512_add_pd(_mm512_loadu_pd(row), sum[r]));
+    }
+}
+__attribute__((target("avx512f"))) void rowAvx512(int depth, const double *a, int aStep, const double *b, int ldb, double *c)
+{
+    __m512d sum = _mm512_setzero_pd();
+    for (int p = 0; p < depth; p++)
+    {
+        sum = _mm512_fmadd_pd(_mm512_set1_pd(a[p * aStep]), _mm512_loadu_pd(b + (size_t)p * ldb), sum);
     }
-    NeuralNetwork() 
+    _mm512_storeu_pd(c, _mm512_add_pd(_mm512_loadu_pd(c), sum));
+}
+typedef void (*TileFunction)(int, const double *, const double *, double *, int);
+typedef void (*GemmRowFunction)(int, const double *, int, const double *, int, double *);
+TileFunction tileKernel = gemv == gemvAvx512 ? tileAvx512 : (gemv == gemvAvx2 ? tileAvx2 : tileScalar);
+GemmRowFunction rowKernel = gemv == gemvAvx512 ? rowAvx512 : (gemv == gemvAvx2 ? rowAvx2 : rowScalar);
+
+// Working space for gemm, owned by whoever calls it (each network has its own) so products
+// for different networks or threads never share buffers. The packed blocks have a fixed
+// size; row and product hold one row of A and of C for products of fewer rows than a tile,
+// and fit(width) makes room for rows that wide. gemm never allocates.
+struct GemmScratch
+{
+    AlignedVector packedA, packedB, row, product;
+    GemmScratch() : packedA((size_t)rowBlock * depthBlock), packedB((size_t)depthBlock * columnBlock) {}
+    void fit(int width)
     {
-        Layer inputLayer;
-        for (int i = 0; i < 8; i++) 
+        if ((size_t)paddedSize(width) > row.size())
         {
-            Neuron neuron;
-            neuron.value = 0;
-            inputLayer.neurons.push_back(neuron);
+            row.assign(paddedSize(width), 0);
+            product.assign(paddedSize(width), 0);
         }
-        layers.push_back(inputLayer);
+    }
+};
 
-        Layer hiddenLayer;
-        double bias = 2.0 * rand() / RAND_MAX - 1;
-        for (int i = 0; i < 8; i++) 
+// C (m x n, rows ldc apart) += alpha * A (m x k) * B (k x n). Element (i, p) of A is
+// a[i * aRow + p * aColumn] and element (p, j) of B is b[p * bRow + j * bColumn], so
+// A * W^T going forward and delta * W and delta^T * A coming back all fit without copies
+// beyond the packing. C's rows need room for n rounded up to a multiple of 8: the extra
+// columns have zeros added to them.
+// With fewer rows than a tile, packing B would cost as much as the product, so each row of
+// A goes through the vector kernels against B in place instead. That needs B laid out like
+// the layers' weights: aligned, with rows (or for B^T, columns) padded with zeros to a
+// multiple of 8, and scratch rows that wide; otherwise the product is packed as usual.
+void gemm(GemmScratch &scratch, int m, int n, int k, double alpha, const double *a, size_t aRow, size_t aColumn,
+          const double *b, size_t bRow, size_t bColumn, double *c, int ldc)
+{
+    AlignedVector &packedA = scratch.packedA, &packedB = scratch.packedB, &row = scratch.row, &product = scratch.product;
+    bool weightLayout = bRow == 1 ? bColumn % 8 == 0 && (size_t)k <= bColumn
+                                  : bColumn == 1 && bRow % 8 == 0 && (size_t)paddedSize(n) <= bRow;
+    size_t width = bRow == 1 ? bColumn : paddedSize(k);
+    if (m < microRows && weightLayout && width <= row.size() && (size_t)paddedSize(n) <= product.size())
+    {
+        fill(row.begin() + k, row.begin() + width, 0);
+        for (int i = 0; i < m; i++)
         {
-            Neuron neuron;
-            neuron.bias = bias;
-            neuron.value = 2.0 * rand() / RAND_MAX - 1;
-            for (int j = 0; j < 8; j++) 
+            double *cRow = c + (size_t)i * ldc;
+            for (int p = 0; p < k; p++)
+            {
+                row[p] = alpha * a[i * aRow + p * aColumn];
+            }
+            if (bRow == 1)
             {
-                double weight = 2.0 * rand() / RAND_MAX - 1;
-                while(weight == 0)
+                // B^T's rows are contiguous, so this row of C is one matrix-vector product
+                gemv(b, n, bColumn, row.data(), product.data());
+                for (int j = 0; j < n; j++)
                 {
-                    weight = 2.0 * rand() / RAND_MAX - 1;
+                    cRow[j] += product[j];
                 }
-                neuron.weights.push_back(weight);
+                continue;
             }
-            hiddenLayer.neurons.push_back(neuron);
-        }
-        layers.push_back(hiddenLayer);
-        Layer outputLayer;
-        Neuron neuron;
-        neuron.value = 2.0 * rand() / RAND_MAX - 1;
-        neuron.bias = 2.0 * rand() / RAND_MAX - 1;
-        for (int j = 0; j < 8; j++)
-        {
-            double weight = 2.0 * rand() / RAND_MAX - 1;
-            while(weight == 0)
+            for (int j = 0; j < n; j += microColumns)
             {
-                weight = 2.0 * rand() / RAND_MAX - 1;
+                rowKernel(k, row.data(), 1, b + j, bRow, cRow + j);
             }
-            neuron.weights.push_back(weight);
         }
-        outputLayer.neurons.push_back(neuron);
-        layers.push_back(outputLayer);
+        return;
     }
-    int forwardPropagate(vector<double> input) 
+    for (int j0 = 0; j0 < n; j0 += columnBlock)
     {
-        for (size_t i = 0; i < layers.size(); i++) 
+        int columns = min(columnBlock, n - j0);
+        int strips = (columns + microColumns - 1) / microColumns;
+        for (int p0 = 0; p0 < k; p0 += depthBlock)
         {
-            Layer &layer = layers[i];
-            for (size_t j = 0; j < layer.neurons.size(); j++) 
+            int depth = min(depthBlock, k - p0);
+            // B's block as strips of 8 columns, each row of a strip next to the one below it
+            for (int t = 0; t < strips; t++)
+            {
+                double *strip = packedB.data() + (size_t)t * depth * microColumns;
+                for (int p = 0; p < depth; p++)
+                {
+                    for (int jj = 0; jj < microColumns; jj++)
+                    {
+                        int j = j0 + t * microColumns + jj;
+                        strip[p * microColumns + jj] = j < n ? b[(p0 + p) * bRow + j * bColumn] : 0;
+                    }
+                }
+            }
+            for (int i0 = 0; i0 < m; i0 += rowBlock)
             {
-                if (i == 0) 
+                int rows = min(rowBlock, m - i0);
+                int tiles = (rows + microRows - 1) / microRows;
+                // A's block as strips of 6 rows, scaled by alpha and padded with zero rows
+                for (int s = 0; s < tiles; s++)
                 {
-                    layer.neurons[j].value = input[j];
+                    double *strip = packedA.data() + (size_t)s * depth * microRows;
+                    for (int p = 0; p < depth; p++)
+                    {
+                        for (int r = 0; r < microRows; r++)
+                        {
+                            int i = i0 + s * microRows + r;
+                            strip[p * microRows + r] = i < m ? alpha * a[i * aRow + (p0 + p) * aColumn] : 0;
+                        }
+                    }
                 }
-                else
+                for (int s = 0; s < tiles; s++)
                 {
-                    Neuron &neuron = layer.neurons[j];
-                    double sum = 0;
-                    for (size_t k = 0; k < neuron.weights.size(); k++)
+                    const double *aStrip = packedA.data() + (size_t)s * depth * microRows;
+                    int tileRows = min(microRows, rows - s * microRows);
+                    for (int t = 0; t < strips; t++)
                     {
-                        sum += neuron.weights[k] * layers[i - 1].neurons[k].value;
+                        const double *bStrip = packedB.data() + (size_t)t * depth * microColumns;
+                        double *tile = c + (size_t)(i0 + s * microRows) * ldc + j0 + t * microColumns;
+                        if (tileRows == microRows)
+                        {
+                            tileKernel(depth, aStrip, bStrip, tile, ldc);
+                        }
+                        else
+                        {
+                            for (int r = 0; r < tileRows; r++)
+                            {
+                                rowKernel(depth, aStrip + r, microRows, bStrip, microColumns, tile + (size_t)r * ldc);
+                            }
+                        }
                     }
-                    neuron.value = sigmoid(sum + neuron.bias);
                 }
             }
         }
-        double output = layers.back().neurons[0].value;
-        return output >= 0.5 ? 1 : 0;
     }
+}
 
-    void backPropagate(vector<double> actualOutputs) 
+// A fully connected layer. Row j of weights holds neuron j's weights from the previous
+// layer, padded with zeros to stride. value is padded to a multiple of 8 with zeros
+// so it can go straight into the next layer's kernel. The input layer only records the
+// input width: inputs are read in place from the dataset.
+class Layer 
+{
+public:
+    int inputs = 0;
+    int outputs = 0;
+    int stride = 0;
+    AlignedVector weights;
+    vector<double> bias;
+    AlignedVector value;
+    vector<double> error;
+    Layer(int inputs, int outputs) : inputs(inputs), outputs(outputs), stride(paddedSize(inputs)),
+        weights((size_t)outputs * stride, 0), bias(outputs, 0), value(paddedSize(outputs), 0), error(outputs, 0) {}
+    double &weight(int j, int k)
     {
-        for (size_t i = 0; i < actualOutputs.size(); i++)
+        return weights[(size_t)j * stride + k];
+    }
+};
+
+class NeuralNetwork 
+{
+private:
+    double learningRate = 0.8;
+    // Space for this network's matrix products: room for a row as wide as any layer, and as
+    // long as the batch once train knows its size
+    GemmScratch scratch;
+public:
+    vector<Layer> layers;
+    double sigmoid(double x) 
+    {
+        return 1.0 / (1.0 + exp(-x));
+    }
+    double sigmoidDerivative(double x) 
+    {
+        double sigmoidValue = sigmoid(x);
+        return sigmoidValue * (1 - sigmoidValue);
+    }
+    // sizes[0] inputs, then the number of neurons in each layer up to the output layer.
+    // Weights are drawn from (-1, 1) excluding 0. Each hidden layer shares one bias, the
+    // output layer draws one per neuron; biases are not trained.
+    NeuralNetwork(const vector<int> &sizes) 
+    {
+        layers.emplace_back(0, sizes[0]);
+        for (size_t l = 1; l < sizes.size(); l++)
         {
-            Layer &outputLayer = layers.back();
-            Neuron &outputNeuron = outputLayer.neurons[i];
-            double outputError = actualOutputs[i] - outputNeuron.value;
-            outputNeuron.error = outputError * sigmoidDerivative(outputNeuron.value);
-            double newWeights[8];
-            for (int i = 0; i < 8; i++)
+            Layer layer(sizes[l - 1], sizes[l]);
+            bool outputLayer = l + 1 == sizes.size();
+            double bias = outputLayer ? 0 : 2.0 * rand() / RAND_MAX - 1;
+            for (int i = 0; i < layer.outputs; i++) 
             {
-                newWeights[i] = outputNeuron.weights[i] + learningRate * outputNeuron.error * layers[1].neurons[i].value;
-            }
-            for (int i = 0; i < 8; i++)
-            {
-                layers[1].neurons[i].error = outputNeuron.error * outputNeuron.weights[i] * sigmoidDerivative(layers[1].neurons[i].value);
-                for (int j = 0; j < 8; j++)
+                layer.value[i] = 2.0 * rand() / RAND_MAX - 1;
+                layer.bias[i] = outputLayer ? 2.0 * rand() / RAND_MAX - 1 : bias;
+                for (int j = 0; j < layer.inputs; j++) 
                 {
-                    layers[1].neurons[i].weights[j] += learningRate * layers[1].neurons[i].error * layers[0].neurons[j].value;
+                    double weight = 2.0 * rand() / RAND_MAX - 1;
+                    while(weight == 0)
+                    {
+                        weight = 2.0 * rand() / RAND_MAX - 1;
+                    }
+                    layer.weight(i, j) = weight;
                 }
             }
-            for (int i = 0; i < 8; i++)
-            {
-                outputNeuron.weights[i] = newWeights[i];
-            }
+            scratch.fit(max(layer.stride, layer.outputs));
+            layers.push_back(layer);
+        }
+    }
+    // Each layer is one matrix-vector product into its value vector, then the bias and sigmoid.
+    // input is a padded dataset row, read in place.
+    int forwardPropagate(const double *input) 
+    {
+        for (size_t i = 1; i < layers.size(); i++) 
+        {
+            Layer &layer = layers[i];
+            const double *previous = i == 1 ? input : layers[i - 1].value.data();
+            gemv(layer.weights.data(), layer.outputs, layer.stride, previous, layer.value.data());
+            sigmoidRow(layer.value.data(), layer.bias.data(), layer.outputs);
         }
+        double output = layers.back().value[0];
+        return output >= 0.5 ? 1 : 0;
     }
 
-    void train(vector<vector<double>> inputs, vector<double> outputs, int epochs, double errorChangeThreshold = 0.0001) 
+    // Trains on batches of batchSize rows (the last one may be smaller). Each batch goes forward
+    // as one matrix product per layer, the errors come back the same way, and the weights
+    // take one step of learningRate times the batch's mean gradient. The network has one
+    // output, whose target is the row's label. A batch is a slice of the dataset, whose padded
+    // rows already are the input layer's activations.
+    void train(const DatasetView &data, int epochs, int batchSize = 1, double errorChangeThreshold = 0.0001) 
     {
+        batchSize = max(1, min(batchSize, (int)data.size()));
+        scratch.fit(batchSize);
+        // One row per sample of the batch: each layer's activations (padded like value) and its deltas
+        vector<AlignedVector> activations(layers.size()), deltas(layers.size());
+        for (size_t l = 1; l < layers.size(); l++)
+        {
+            activations[l].assign((size_t)batchSize * paddedSize(layers[l].outputs), 0);
+            deltas[l].assign((size_t)batchSize * paddedSize(layers[l].outputs), 0);
+        }
         double previousMeanError = 0.0;
         for (int epoch = 0; epoch < epochs; epoch++) 
         {
             double totalError = 0;
-            for (size_t i = 0; i < inputs.size(); i++) 
+            for (size_t first = 0; first < data.size(); first += batchSize) 
             {
-                int prediction = forwardPropagate(inputs[i]);
-                backPropagate({outputs[i]});
-                double error = pow(outputs[i] - prediction, 2);
-                totalError += error;
+                DatasetView batch = data.slice(first, min((size_t)batchSize, data.size() - first));
+                int rows = batch.size();
+                forwardBatch(batch.data, activations, rows);
+                Layer &outputLayer = layers.back();
+                int outputWidth = paddedSize(outputLayer.outputs);
+                for (int b = 0; b < rows; b++)
+                {
+                    int prediction = activations.back()[(size_t)b * outputWidth] >= 0.5 ? 1 : 0;
+                    totalError += pow(batch.label(b) - prediction, 2);
+                }
+                backwardBatch(batch.data, activations, deltas, batch.labels, rows);
             }
-            double meanError = totalError / inputs.size();
+            double meanError = totalError / data.size();
             cout << "Epoch: " << epoch + 1 << ", Error: " << meanError << endl;
 
             if (epoch > 0 && abs(previousMeanError - meanError) < errorChangeThreshold)
@@ -165,59 +570,74 @@ public:
         }
     }
 
-    vector<int> predict(vector<vector<double>> inputs) 
+    // input holds the batch's rows, stride apart; activations[0] is not used
+    void forwardBatch(const double *input, vector<AlignedVector> &activations, int rows)
     {
-        vector<int> predictions;
-        for (size_t i = 0; i < inputs.size(); i++)
+        for (size_t l = 1; l < layers.size(); l++)
         {
-            predictions.push_back(forwardPropagate(inputs[i]));
+            Layer &layer = layers[l];
+            int width = paddedSize(layer.outputs);
+            double *output = activations[l].data();
+            const double *previous = l == 1 ? input : activations[l - 1].data();
+            // activations = previous activations * weights^T
+            fill(activations[l].begin(), activations[l].begin() + (size_t)rows * width, 0);
+            gemm(scratch, rows, layer.outputs, layer.inputs, 1, previous, layer.stride, 1, layer.weights.data(), 1, layer.stride, output, width);
+            for (int b = 0; b < rows; b++)
+            {
+                sigmoidRow(output + (size_t)b * width, layer.bias.data(), layer.outputs);
+            }
         }
-        return predictions;
-    }
-};
-
-vector<string> split(const string &s, char delimiter) 
-{
-    vector<string> tokens;
-    string token;
-    istringstream tokenStream(s);
-    while (getline(tokenStream, token, delimiter)) 
-    {
-        tokens.push_back(token);
     }
-    return tokens;
-}
-
-pair<vector<vector<double>>, vector<double>> readData(const string &filename) 
-{
-    ifstream file(filename);
-    vector<vector<double>> inputs;
-    vector<double> outputs;
 
-    if (!file.is_open()) 
+    // All deltas are worked out with the weights as they were before the batch, then
+    // every layer's weights take the step lr/rows * delta^T * previous activations
+    void backwardBatch(const double *input, vector<AlignedVector> &activations, vector<AlignedVector> &deltas, const double *targets, int rows)
     {
-        cout << "Unable to open file" << endl;
-        return make_pair(inputs, outputs);
+        for (size_t l = layers.size() - 1; l >= 1; l--)
+        {
+            Layer &layer = layers[l];
+            int width = paddedSize(layer.outputs);
+            const double *value = activations[l].data();
+            double *delta = deltas[l].data();
+            if (l + 1 == layers.size())
+            {
+                for (int b = 0; b < rows; b++)
+                {
+                    double outputError = targets[b] - value[(size_t)b * width];
+                    delta[(size_t)b * width] = outputError * sigmoidDerivative(value[(size_t)b * width]);
+                }
+            }
+            else
+            {
+                // delta = (next layer's delta * its weights), times the derivative
+                Layer &next = layers[l + 1];
+                fill(deltas[l].begin(), deltas[l].begin() + (size_t)rows * width, 0);
+                gemm(scratch, rows, layer.outputs, next.outputs, 1, deltas[l + 1].data(), paddedSize(next.outputs), 1, next.weights.data(), next.stride, 1, delta, width);
+                for (int b = 0; b < rows; b++)
+                {
+                    derivativeRow(delta + (size_t)b * width, value + (size_t)b * width, layer.outputs);
+                }
+            }
+        }
+        double scale = learningRate / rows;
+        for (size_t l = 1; l < layers.size(); l++)
+        {
+            Layer &layer = layers[l];
+            const double *previous = l == 1 ? input : activations[l - 1].data();
+            gemm(scratch, layer.outputs, layer.inputs, rows, scale, deltas[l].data(), 1, paddedSize(layer.outputs), previous, layer.stride, 1, layer.weights.data(), layer.stride);
+        }
     }
 
-    string line;
-    getline(file, line);
-    while (getline(file, line)) 
+    vector<int> predict(const DatasetView &data) 
     {
-        vector<string> tokens = split(line, ',');
-        vector<double> input;
-        for (size_t i = 0; i < tokens.size() - 1; i++) 
+        vector<int> predictions;
+        for (size_t i = 0; i < data.size(); i++)
         {
-            input.push_back(stod(tokens[i]));
+            predictions.push_back(forwardPropagate(data.row(i)));
         }
-        inputs.push_back(input);
-        outputs.push_back(stod(tokens.back()));
+        return predictions;
     }
-
-    file.close();
-
-    return make_pair(inputs, outputs);
-}
+};
 
 struct Metrics 
 {
@@ -227,13 +647,13 @@ struct Metrics
     double fMeasure;
 };
 
-Metrics calculateMetrics(NeuralNetwork& nn, const vector<vector<double>>& testInputs, const vector<double>& testOutputs) 
+Metrics calculateMetrics(NeuralNetwork& nn, const DatasetView& testData) 
 {
     int TP = 0, TN = 0, FP = 0, FN = 0;
-    vector<int> predictions = nn.predict(testInputs);
-    for (size_t i = 0; i < testInputs.size(); ++i) {
+    vector<int> predictions = nn.predict(testData);
+    for (size_t i = 0; i < testData.size(); ++i) {
         int predictedOutput = predictions[i];
-        int actualOutput = testOutputs[i];
+        int actualOutput = testData.label(i);
         if (predictedOutput == actualOutput) {
             if (predictedOutput == 1) {
                 ++TP;
@@ -255,25 +675,60 @@ Metrics calculateMetrics(NeuralNetwork& nn, const vector<vector<double>>& testIn
     return {accuracy, specificity, sensitivity, fMeasure};
 }
 
-int main() 
+int main(int argc, char *argv[]) 
 {
+    // Rows per training batch; 1 is plain per-sample gradient descent
+    int batchSize = 1;
+    // Scales both sets by the training set's column stats when on
+    bool standardise = false;
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (argument == "--batch-size" && i + 1 < argc)
+        {
+            batchSize = max(1, atoi(argv[++i]));
+        }
+        else if (argument == "--standardise")
+        {
+            standardise = true;
+        }
+        else
+        {
+            cerr << "Usage: " << argv[0] << " [--batch-size n] [--standardise]" << endl;
+            return 1;
+        }
+    }
     cout << "Enter the seed: ";
     int seed;
     cin >> seed;
     srand(seed);
-    pair<vector<vector<double>>, vector<double>> trainingData = readData("mushroom_train.csv");
-    pair<vector<vector<double>>, vector<double>> testData = readData("mushroom_test.csv");
+    // Saturated sigmoids push deltas into the subnormal range, where every multiply is a
+    // microcode assist; flushing them to zero more than halves an AVX2 epoch
+    _MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
+    _MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
+    Dataset trainingData, testData;
+    if (!loadDataset("mushroom_train.csv", trainingData) || !loadDataset("mushroom_test.csv", testData))
+    {
+        return 1;
+    }
+    if (standardise)
+    {
+        vector<ColumnStats> stats = trainingData.view().columnStats();
+        trainingData.standardise(stats);
+        testData.standardise(stats);
+    }
     auto start = chrono::high_resolution_clock::now();
-    NeuralNetwork nn;
+    int hiddenNeurons = 8;
+    NeuralNetwork nn({trainingData.columns, hiddenNeurons, 1});
     int epochs = 50;
-    nn.train(trainingData.first, trainingData.second, epochs);
+    nn.train(trainingData, epochs, batchSize);
 
-    vector<int> predictions = nn.predict(testData.first);
+    vector<int> predictions = nn.predict(testData);
 
     auto end = chrono::high_resolution_clock::now();
     auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
     cout << "Time taken: " << duration.count() << "ms" << endl;
-    Metrics metrics = calculateMetrics(nn, testData.first, testData.second);
+    Metrics metrics = calculateMetrics(nn, testData);
     cout << "Accuracy: " << metrics.accuracy * 100 << "%" << endl;
     cout << "Specificity: " << metrics.specificity << endl;
     cout << "Sensitivity: " << metrics.sensitivity << endl;